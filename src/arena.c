@@ -0,0 +1,115 @@
+#include "arena.h"
+
+#include <stdlib.h>
+
+#define ARENA_ALIGN 16
+#define ARENA_MIN_BLOCK 4096
+#define ARENA_SHRINK_RESETS 16  /* small rounds in a row before the block shrinks */
+
+struct arena_block
+{
+    arena_block_t *next;
+    size_t size;
+    uint8_t data[] __attribute__((aligned(ARENA_ALIGN)));
+};
+
+static inline size_t align_up(size_t n)
+{
+    return (n + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+// returns success (0) or failure (1)
+static int push_block(arena_t *this, size_t size)
+{
+    if(size > SIZE_MAX - sizeof(arena_block_t))
+        return 1;
+    arena_block_t *block = malloc(sizeof(arena_block_t) + size);
+    if(block == NULL)
+        return 1;
+
+    block->next = this->head;
+    block->size = size;
+    this->head = block;
+    this->used = 0;
+    this->num_blocks++;
+    return 0;
+}
+
+static void free_blocks(arena_t *this)
+{
+    arena_block_t *block = this->head;
+    while(block != NULL) {
+        arena_block_t *next = block->next;
+        free(block);
+        block = next;
+    }
+    this->head = NULL;
+    this->used = 0;
+}
+
+void arena_init(arena_t *this)
+{
+    this->head = NULL;
+    this->used = 0;
+    this->total = 0;
+    this->num_allocs = 0;
+    this->num_blocks = 0;
+    this->num_small_resets = 0;
+}
+
+void arena_cleanup(arena_t *this)
+{
+    free_blocks(this);
+}
+
+void *arena_alloc(arena_t *this, size_t size)
+{
+    if(size > SIZE_MAX / 2)
+        return NULL;
+    size = align_up(size);
+
+    if(this->head == NULL || this->head->size - this->used < size) {
+        size_t blocksz = (this->head != NULL) ? this->head->size * 2 : ARENA_MIN_BLOCK;
+        while(blocksz < size)
+            blocksz *= 2;
+        if(push_block(this, blocksz) != 0)
+            return NULL;
+    }
+
+    void *p = this->head->data + this->used;
+    this->used += size;
+    this->total += size;
+    this->num_allocs++;
+    return p;
+}
+
+void arena_reset(arena_t *this)
+{
+    size_t size = align_up(this->total);
+    if(this->head != NULL && this->head->next != NULL) {
+        // several blocks: replace them by one that fits the whole last round
+        free_blocks(this);
+        push_block(this, size);
+        this->num_small_resets = 0;
+    } else if(this->head != NULL && this->head->size > ARENA_MIN_BLOCK && size < this->head->size / 4) {
+        // a block much bigger than needed for a while: shrink it
+        if(++this->num_small_resets >= ARENA_SHRINK_RESETS) {
+            free_blocks(this);
+            push_block(this, (2 * size > ARENA_MIN_BLOCK) ? 2 * size : ARENA_MIN_BLOCK);
+            this->num_small_resets = 0;
+        }
+    } else {
+        this->num_small_resets = 0;
+    }
+
+    this->used = 0;
+    this->total = 0;
+}
+
+size_t arena_capacity(const arena_t *this)
+{
+    size_t n = 0;
+    for(const arena_block_t *block = this->head; block != NULL; block = block->next)
+        n += block->size;
+    return n;
+}
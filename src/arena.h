@@ -0,0 +1,47 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* a bump allocator: allocations are never freed one by one, the whole
+   arena is reset at once. After a reset, the arena keeps a single block
+   big enough for everything allocated since the previous reset, so a
+   steady workload stops calling malloc() altogether. That block shrinks
+   again once the rounds need a lot less, so one huge round doesn't keep
+   its memory forever.
+*/
+
+typedef struct arena_block arena_block_t;
+
+typedef struct
+{
+    arena_block_t *head;  // the current block, older ones follow
+    size_t used;          // bytes used in the current block
+    size_t total;         // bytes allocated since the last reset
+
+    uint64_t num_allocs;  // allocations served, since init
+    uint64_t num_blocks;  // blocks malloc'ed, since init
+    int num_small_resets; // consecutive rounds using under a quarter of the block
+
+} arena_t;
+
+void arena_init(arena_t *this);
+void arena_cleanup(arena_t *this);
+
+// returns 'size' bytes, aligned for any type, or NULL when out of memory
+void *arena_alloc(arena_t *this, size_t size);
+void arena_reset(arena_t *this);
+
+// the size of the memory currently held by the arena
+size_t arena_capacity(const arena_t *this);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* ARENA_H */
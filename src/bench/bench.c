@@ -0,0 +1,113 @@
+#include "bench.h"
+#include "../timeutil.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#define DEFAULT_RUNS 5
+
+static int num_runs = DEFAULT_RUNS;
+static const char *filter = NULL;  /* substring of the benchmarks to run, NULL for all */
+static int num_failures = 0;
+
+int bench_is_selected(const char *name)
+{
+    return filter == NULL || strstr(name, filter) != NULL;
+}
+
+double bench_run(const char *name, bench_func_t func, void *arg, uint64_t iters)
+{
+    if(!bench_is_selected(name))
+        return 0.0;
+
+    uint64_t best = UINT64_MAX;
+    for(int r = 0; r < num_runs; r++) {
+        ss_timer_t timer;
+        tmr_tic(&timer);
+        func(arg, iters);
+        uint64_t elapsed = tmr_toc(&timer);
+        if(elapsed < best)
+            best = elapsed;
+    }
+
+    printf("%-44s %12.1f ns/op %10"PRIu64" ops\n", name, (double) best / iters, iters);
+    fflush(stdout);
+    return (double) best / iters;
+}
+
+void bench_fail(const char *name, const char *why)
+{
+    printf("FAIL %s: %s\n", name, why);
+    fflush(stdout);
+    num_failures++;
+}
+
+static void usage(const char *progname)
+{
+    fprintf(stderr, "usage: %s [options] LIB.so\n", progname);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "    Microbenchmarks of the lcm-spy-lite hot paths, LIB.so is the\n");
+    fprintf(stderr, "    library of bench lcmtypes built by 'make bench'.\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -r, --runs N       runs per benchmark, the best is reported (default: %d)\n",
+            DEFAULT_RUNS);
+    fprintf(stderr, "  -f, --filter TEXT  only run the benchmarks whose name contains TEXT\n");
+    fprintf(stderr, "  -h, --help         shows this help text and exits\n");
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option long_opts[] = {
+        { "runs",   required_argument, NULL, 'r' },
+        { "filter", required_argument, NULL, 'f' },
+        { "help",   no_argument,       NULL, 'h' },
+        { 0, 0, 0, 0 }
+    };
+
+    int c;
+    while((c = getopt_long(argc, argv, "r:f:h", long_opts, NULL)) >= 0) {
+        switch(c) {
+            case 'r':
+                num_runs = atoi(optarg);
+                if(num_runs <= 0) {
+                    fprintf(stderr, "ERR: invalid number of runs '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'f':
+                filter = optarg;
+                break;
+            case 'h':
+            default:
+                usage(argv[0]);
+                return (c == 'h') ? 0 : 1;
+        }
+    }
+    if(optind != argc - 1) {
+        usage(argv[0]);
+        return 1;
+    }
+    const char *lib = argv[optind];
+
+    lcmtype_db_t *db = lcmtype_db_create(lib, NULL, 0);
+    if(db == NULL || lcmtype_db_get_using_name(db, "bench_path_t") == NULL) {
+        fprintf(stderr, "ERR: failed to load the bench lcmtypes from '%s'\n", lib);
+        return 1;
+    }
+
+    printf("# lcm-spy-lite bench: best of %d runs\n", num_runs);
+    bench_spy(db);
+    bench_display(db);
+    bench_typedb(lib);
+
+    lcmtype_db_destroy(db);
+    if(num_failures > 0) {
+        printf("# %d check(s) failed\n", num_failures);
+        return 1;
+    }
+    return 0;
+}
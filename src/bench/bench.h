@@ -0,0 +1,40 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "../lcmtype_db.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* a minimal microbenchmark harness: every benchmark runs 'iters'
+   operations per run, and the best run is reported in ns per operation.
+   The best run is the least disturbed one, so the numbers are stable
+   enough to be diffed between two builds.
+*/
+
+typedef void (*bench_func_t)(void *arg, uint64_t iters);
+
+// times 'func' if 'name' passes the filter, and prints its line
+// returns the best ns per operation, 0 when filtered out
+double bench_run(const char *name, bench_func_t func, void *arg, uint64_t iters);
+
+// reports a failed check of the benchmark 'name': prints a FAIL line,
+// and the bench then exits with a non-zero status
+void bench_fail(const char *name, const char *why);
+
+// non-zero if 'name' passes the filter, to skip the setup of filtered out benchmarks
+int bench_is_selected(const char *name);
+
+// the benchmark groups, on the db/library of the bench lcmtypes
+void bench_spy(lcmtype_db_t *db);
+void bench_display(lcmtype_db_t *db);
+void bench_typedb(const char *lib);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* BENCH_H */
@@ -0,0 +1,395 @@
+/* benchmarks of msg_display() on large messages, as the decode screen
+   redraws them: a screenful of lines at the top, inside a nested struct
+   and at the end of a 100k-point path and of a 640x480 image. The whole
+   image is also rendered with the hand-written formatters and with one
+   printf() per value, the way msg_display() used to format. The double
+   formatter is also timed and checked against printf() on its own */
+#include "bench.h"
+#include "lcmtypes/bench_nested.h"
+#include "../msg_display.h"
+#include "../strbuf.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_POINTS 100000
+#define BENCH_IMAGE_HEIGHT 480
+#define BENCH_IMAGE_WIDTH 640
+#define BENCH_SCREEN_LINES 50
+#define BENCH_FRAMES 1000
+#define BENCH_FULL_FRAMES 10  /* of every line of the image */
+#define BENCH_DOUBLES 100000
+
+typedef struct
+{
+    lcmtype_db_t *db;
+    const lcmtype_metadata_t *metadata;
+    void *msg;
+    msg_display_state_t state;
+    msg_display_cache_t cache;
+    int use_cache;
+    msg_display_viewport_t viewport;
+    strbuf_t out;
+
+} display_bench_t;
+
+static void bench_msg_display(void *arg, uint64_t iters)
+{
+    display_bench_t *this = arg;
+    for(uint64_t i = 0; i < iters; i++) {
+        strbuf_clear(&this->out);
+        msg_display(&this->out, this->db, this->metadata, this->msg, &this->state,
+                    this->use_cache ? &this->cache : NULL, &this->viewport);
+    }
+}
+
+/* the printf() path: renders every line of a top-level message like
+   msg_display() does, with a printf conversion per value */
+static void printf_value(strbuf_t *out, const lcmtype_field_t *field, const void *data, int64_t usertype_id)
+{
+    switch(field->type) {
+        case LCM_FIELD_BYTE:
+        case LCM_FIELD_INT8_T: {
+            int8_t i = *(const int8_t *) data;
+            strbuf_printf(out, " %d", i);
+            if(32 <= i && i <= 126)
+                strbuf_printf(out, " (%c)", i);
+            break;
+        }
+        case LCM_FIELD_INT16_T:  strbuf_printf(out, "% d", *(const int16_t *) data); break;
+        case LCM_FIELD_INT32_T:  strbuf_printf(out, "% d", *(const int32_t *) data); break;
+        case LCM_FIELD_INT64_T:  strbuf_printf(out, "% "PRIi64, *(const int64_t *) data); break;
+        case LCM_FIELD_FLOAT:    strbuf_printf(out, "% f", *(const float *) data); break;
+        case LCM_FIELD_DOUBLE:   strbuf_printf(out, "% f", *(const double *) data); break;
+        case LCM_FIELD_STRING:   strbuf_printf(out, "\"%s\"", *(const char * const *) data); break;
+        case LCM_FIELD_BOOLEAN:
+            strbuf_printf(out, "%s", (*(const int8_t *) data) == 1 ? "true" : "false");
+            break;
+        case LCM_FIELD_USER_TYPE:
+            if(field->usertype == NULL)
+                strbuf_printf(out, "<unknown-user-type>");
+            else
+                strbuf_printf(out, "<%"PRIi64">", usertype_id);
+            break;
+        default:
+            strbuf_printf(out, "???");
+            break;
+    }
+}
+
+#define PRINTF_LINE_FMT "    %-20.20s %-20.20s "
+#define PRINTF_ELT_PER_LINE 10
+
+static void printf_array(strbuf_t *out, const lcmtype_fields_t *fields, const lcmtype_field_t *field,
+                         const void *msg, int64_t *usertype_count)
+{
+    const void *data = (const uint8_t *) msg + field->offset;
+    int32_t dims[LCM_TYPE_FIELD_MAX_DIM];
+    int64_t num_rows = 1;
+    int label_width = 0;
+    for(int d = 0; d < field->num_dim; d++) {
+        dims[d] = lcmtype_fields_dim_size(fields, field, msg, d);
+        if(dims[d] < 0)
+            dims[d] = 0;
+        if(d < field->num_dim - 1) {
+            num_rows *= dims[d];
+            label_width += snprintf(NULL, 0, "[%d]", dims[d] > 0 ? dims[d] - 1 : 0);
+        }
+    }
+    int32_t row_len = dims[field->num_dim - 1];
+
+    if(field->num_dim > 1) {
+        strbuf_printf(out, PRINTF_LINE_FMT, field->name, field->typestr);
+        for(int d = 0; d < field->num_dim; d++)
+            strbuf_printf(out, "[%d]", dims[d]);
+        strbuf_printf(out, "\n");
+    }
+
+    for(int64_t row = 0; row < num_rows; row++) {
+        // the row's indices, and its first value
+        int32_t index[LCM_TYPE_FIELD_MAX_DIM];
+        int64_t r = row;
+        for(int d = field->num_dim - 2; d >= 0; d--) {
+            index[d] = r % dims[d];
+            r /= dims[d];
+        }
+        const uint8_t *p;
+        if(!field->has_variable_dim) {
+            p = (const uint8_t *) data + row * row_len * field->elt_size;
+        } else {
+            p = *(void * const *) data;
+            for(int d = 0; d < field->num_dim - 1 && p != NULL; d++)
+                p = ((void * const *) p)[index[d]];
+        }
+
+        char label[128];
+        size_t used = 0;
+        label[0] = '\0';
+        for(int d = 0; d < field->num_dim - 1; d++)
+            used += snprintf(label + used, sizeof(label) - used, "[%d]", index[d]);
+
+        for(int32_t i = 0; i < row_len || i == 0; i++) {
+            if(i % PRINTF_ELT_PER_LINE == 0) {
+                if(i != 0)
+                    strbuf_printf(out, "\n");
+                if(field->num_dim == 1 && i == 0)
+                    strbuf_printf(out, PRINTF_LINE_FMT, field->name, field->typestr);
+                else if(field->num_dim == 1)
+                    strbuf_printf(out, PRINTF_LINE_FMT, "", "");
+                else
+                    strbuf_printf(out, PRINTF_LINE_FMT "%-*s ", "", "", label_width, (i == 0) ? label : "");
+                strbuf_printf(out, "%c", (i == 0) ? '[' : ' ');
+            }
+            if(i >= row_len || p == NULL)
+                break;
+            printf_value(out, field, p + i * field->elt_size, *usertype_count + 1 + row * row_len + i);
+            if(i+1 != row_len)
+                strbuf_printf(out, ", ");
+        }
+        strbuf_printf(out, " ]\n");
+    }
+
+    if(field->type == LCM_FIELD_USER_TYPE)
+        *usertype_count += num_rows * row_len;
+}
+
+static void printf_display(strbuf_t *out, lcmtype_db_t *db, const lcmtype_metadata_t *metadata, void *msg)
+{
+    const lcmtype_fields_t *fields = lcmtype_db_get_fields(db, metadata);
+    int64_t usertype_count = 0;
+
+    strbuf_printf(out, "         Traversal: %s \n", "top");
+    strbuf_printf(out, "   ----------------------------------------------------------------\n");
+    for(int i = 0; i < fields->num_fields; i++) {
+        const lcmtype_field_t *field = &fields->fields[i];
+        if(field->num_dim > 0) {
+            printf_array(out, fields, field, msg, &usertype_count);
+            continue;
+        }
+        usertype_count += (field->type == LCM_FIELD_USER_TYPE);
+        strbuf_printf(out, PRINTF_LINE_FMT, field->name, field->typestr);
+        printf_value(out, field, (uint8_t *) msg + field->offset, usertype_count);
+        strbuf_printf(out, "\n");
+    }
+}
+
+static void bench_printf_display(void *arg, uint64_t iters)
+{
+    display_bench_t *this = arg;
+    for(uint64_t i = 0; i < iters; i++) {
+        strbuf_clear(&this->out);
+        printf_display(&this->out, this->db, this->metadata, this->msg);
+    }
+}
+
+static void bench_msg_display_all(void *arg, uint64_t iters)
+{
+    display_bench_t *this = arg;
+    for(uint64_t i = 0; i < iters; i++) {
+        strbuf_clear(&this->out);
+        msg_display(&this->out, this->db, this->metadata, this->msg, &this->state, &this->cache, NULL);
+    }
+}
+
+/* every line of the message, with both formatters: they must agree */
+static void bench_full_render(display_bench_t *this, const char *name)
+{
+    char printf_name[128];
+    snprintf(printf_name, sizeof(printf_name), "%s/printf", name);
+
+    strbuf_t expected;
+    strbuf_init(&expected);
+    strbuf_clear(&this->out);
+    msg_display(&this->out, this->db, this->metadata, this->msg, &this->state, NULL, NULL);
+    strbuf_append(&expected, this->out.data, this->out.len);
+    strbuf_clear(&this->out);
+    printf_display(&this->out, this->db, this->metadata, this->msg);
+    if(this->out.len != expected.len || memcmp(this->out.data, expected.data, expected.len) != 0)
+        printf("# WRN: %s: the printf path renders differently\n", name);
+    strbuf_cleanup(&expected);
+
+    bench_run(name, bench_msg_display_all, this, BENCH_FULL_FRAMES);
+    bench_run(printf_name, bench_printf_display, this, BENCH_FULL_FRAMES);
+}
+
+// scrolls to the last screenful of the message
+static void scroll_to_end(display_bench_t *this)
+{
+    strbuf_clear(&this->out);
+    size_t num_lines = msg_display(&this->out, this->db, this->metadata, this->msg,
+                                   &this->state, NULL, &this->viewport);
+    this->viewport.first_line = (num_lines > BENCH_SCREEN_LINES) ? num_lines - BENCH_SCREEN_LINES : 0;
+}
+
+static void bench_path(display_bench_t *this)
+{
+    bench_path_t *msg = calloc(1, sizeof(bench_path_t));
+    msg->utime = 1400000000000000LL;
+    msg->frame = "bench";
+    msg->origin = (bench_point_t) { .utime = msg->utime, .x = 1.0, .y = 2.0, .z = 3.0 };
+    msg->num_points = BENCH_POINTS;
+    msg->points = calloc(BENCH_POINTS, sizeof(bench_point_t));
+    for(int i = 0; i < BENCH_POINTS; i++)
+        msg->points[i] = (bench_point_t) { .utime = msg->utime + i, .x = i, .y = -i, .z = 0.5 * i };
+    for(int i = 0; i < 36; i++)
+        msg->cov[i] = (i % 7 == 0) ? 1.0 : 0.001 * i;
+    for(int r = 0; r < BENCH_GRID_ROWS; r++)
+        for(int c = 0; c < BENCH_GRID_COLS; c++)
+            msg->grid[r][c] = r * BENCH_GRID_COLS + c;
+
+    this->metadata = lcmtype_db_get_using_name(this->db, "bench_path_t");
+    this->msg = msg;
+
+    // the top message, then its nested messages: 'origin' is the first one,
+    // the points follow. Only paths through fixed-size fields are cached
+    this->state.cur_depth = 0;
+    this->use_cache = 1; /* true */
+    this->viewport.first_line = 0;
+    bench_run("msg_display/bench_path_t", bench_msg_display, this, BENCH_FRAMES);
+    scroll_to_end(this);
+    bench_run("msg_display/bench_path_t/end", bench_msg_display, this, BENCH_FRAMES);
+
+    this->state.cur_depth = 1;
+    this->state.recur_table[0] = 1;
+    this->viewport.first_line = 0;
+    bench_run("msg_display/bench_path_t/origin", bench_msg_display, this, BENCH_FRAMES);
+    this->use_cache = 0; /* false */
+    bench_run("msg_display/bench_path_t/origin/no_cache", bench_msg_display, this, BENCH_FRAMES);
+    this->state.recur_table[0] = 2 + 500;
+    bench_run("msg_display/bench_path_t/points[500]", bench_msg_display, this, BENCH_FRAMES);
+
+    free(msg->points);
+    free(msg);
+}
+
+static void bench_image(display_bench_t *this)
+{
+    bench_image_t *msg = calloc(1, sizeof(bench_image_t));
+    msg->utime = 1400000000000000LL;
+    msg->height = BENCH_IMAGE_HEIGHT;
+    msg->width = BENCH_IMAGE_WIDTH;
+    msg->data = calloc(BENCH_IMAGE_HEIGHT, sizeof(uint8_t *));
+    for(int r = 0; r < BENCH_IMAGE_HEIGHT; r++) {
+        msg->data[r] = malloc(BENCH_IMAGE_WIDTH);
+        memset(msg->data[r], r, BENCH_IMAGE_WIDTH);
+    }
+
+    this->metadata = lcmtype_db_get_using_name(this->db, "bench_image_t");
+    this->msg = msg;
+    this->state.cur_depth = 0;
+    this->use_cache = 1; /* true */
+
+    this->viewport.first_line = 0;
+    bench_run("msg_display/bench_image_t", bench_msg_display, this, BENCH_FRAMES);
+    scroll_to_end(this);
+    bench_run("msg_display/bench_image_t/end", bench_msg_display, this, BENCH_FRAMES);
+    bench_full_render(this, "msg_display/bench_image_t/all_lines");
+
+    for(int r = 0; r < BENCH_IMAGE_HEIGHT; r++)
+        free(msg->data[r]);
+    free(msg->data);
+    free(msg);
+}
+
+typedef struct
+{
+    double *values;
+    int decimals;
+    strbuf_t out;
+
+} doubles_bench_t;
+
+static void bench_append_double(void *arg, uint64_t iters)
+{
+    doubles_bench_t *this = arg;
+    for(uint64_t i = 0; i < iters; i++) {
+        strbuf_clear(&this->out);
+        strbuf_append_double(&this->out, this->values[i % BENCH_DOUBLES], this->decimals);
+    }
+}
+
+static void bench_printf_double(void *arg, uint64_t iters)
+{
+    doubles_bench_t *this = arg;
+    for(uint64_t i = 0; i < iters; i++) {
+        strbuf_clear(&this->out);
+        strbuf_printf(&this->out, "%.*f", this->decimals, this->values[i % BENCH_DOUBLES]);
+    }
+}
+
+// every value must be formatted exactly like printf() does it, ties included
+static void check_doubles(doubles_bench_t *this, const char *name)
+{
+    strbuf_t expected;
+    strbuf_init(&expected);
+
+    int num_bad = 0;
+    char why[256];
+    for(int decimals = 0; decimals <= 9; decimals++) {
+        for(int i = 0; i < BENCH_DOUBLES; i++) {
+            double v = this->values[i];
+            strbuf_clear(&this->out);
+            strbuf_append_double(&this->out, v, decimals);
+            strbuf_clear(&expected);
+            strbuf_printf(&expected, "%.*f", decimals, v);
+            if(this->out.len == expected.len && memcmp(this->out.data, expected.data, expected.len) == 0)
+                continue;
+            if(num_bad++ == 0)
+                snprintf(why, sizeof(why), "%.17g with %d decimals gives '%.*s' instead of '%s'",
+                         v, decimals, (int) this->out.len, this->out.data, expected.data);
+        }
+    }
+    if(num_bad > 0)
+        bench_fail(name, why);
+
+    strbuf_cleanup(&expected);
+}
+
+static void bench_doubles(void)
+{
+    doubles_bench_t *this = calloc(1, sizeof(doubles_bench_t));
+    strbuf_init(&this->out);
+
+    // half of them have few decimals, like the values of a message often do:
+    // the ones that look like ties (0.9075) are the hard ones to round
+    this->values = malloc(BENCH_DOUBLES * sizeof(double));
+    uint64_t x = 88172645463325252ULL;
+    for(int i = 0; i < BENCH_DOUBLES; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        double sign = (x & 1) ? -1.0 : 1.0;
+        if(i % 2 == 0)
+            this->values[i] = sign * (double) (x >> 40) / pow(10.0, (double) ((x >> 1) % 8));
+        else
+            this->values[i] = sign * ldexp((double) (x >> 11), (int) ((x >> 1) % 64) - 80);
+    }
+
+    if(bench_is_selected("strbuf/double"))
+        check_doubles(this, "strbuf/double");
+    this->decimals = 6;  /* like msg_display() */
+    bench_run("strbuf/double", bench_append_double, this, BENCH_DOUBLES);
+    bench_run("strbuf/double/printf", bench_printf_double, this, BENCH_DOUBLES);
+
+    free(this->values);
+    strbuf_cleanup(&this->out);
+    free(this);
+}
+
+void bench_display(lcmtype_db_t *db)
+{
+    display_bench_t *this = calloc(1, sizeof(display_bench_t));
+    this->db = db;
+    this->viewport.num_lines = BENCH_SCREEN_LINES;
+    strbuf_init(&this->out);
+
+    bench_path(this);
+    bench_image(this);
+    bench_doubles();
+
+    strbuf_cleanup(&this->out);
+    free(this);
+}
@@ -0,0 +1,392 @@
+/* benchmarks of the per-message and per-frame paths of main.c. Those are
+   static, so main.c is compiled into this file, with its main() renamed.
+   The spy is set up by hand, like main() would for a single url (without
+   workers, but for the worker benchmarks), and fed synthetic messages of
+   the generated bench lcmtypes.
+*/
+#define main lcm_spy_lite_main
+#include "../main.c"
+#undef main
+
+#include "bench.h"
+
+#include <errno.h>
+
+#define BENCH_CHANNELS 10000
+#define BENCH_TYPES 100
+#define BENCH_FRAMES 20
+
+/* the "terminal" of the print thread stress test: a pipe drained by
+   SLOW_TERMINAL_CHUNK bytes every SLOW_TERMINAL_PERIOD usec (~1 MB/s) */
+#define SLOW_TERMINAL_CHUNK 1024
+#define SLOW_TERMINAL_PERIOD 1000
+
+/* receiving may be at most this much slower with the slow terminal: the
+   print thread blocking on the terminal must not hold up the receive path */
+#define SLOW_TERMINAL_MAX_SLOWDOWN 2.0
+
+/* the layout of the types written by lcmtypes/gen_lcmtypes.c */
+typedef struct
+{
+    int64_t utime;
+    double value;
+
+} gen_msg_t;
+
+typedef struct
+{
+    spyinfo_t spy;
+    provider_t provider;
+
+    int num_channels;
+    char **channels;
+    lcm_recv_buf_t *bufs;  /* one encoded message per channel */
+
+    view_t view;
+    strbuf_t out;
+
+} spy_bench_t;
+
+static int spy_bench_init(spy_bench_t *this, lcmtype_db_t *db)
+{
+    memset(this, 0, sizeof(spy_bench_t));
+    strbuf_init(&this->out);
+
+    spyinfo_t *spy = &this->spy;
+    spy->providers = &this->provider;
+    spy->num_providers = 1;
+    spy->type_db = db;
+    spy->use_arena = 1; /* true */
+    spy->time_field = DEFAULT_TIME_FIELD;
+    spy->channels = g_ptr_array_new();
+    pthread_mutex_init(&spy->channels_mutex, NULL);
+    pthread_mutex_init(&spy->ui_mutex, NULL);
+    pthread_mutex_init(&spy->recorder_mutex, NULL);
+    pthread_cond_init(&spy->redraw_cond, NULL);
+
+    provider_t *provider = &this->provider;
+    provider->spy = spy;
+    provider->minfo_hashtbl = g_hash_table_new_full(g_str_hash, g_str_equal,
+                   (GDestroyNotify) free, (GDestroyNotify) msg_info_destroy);
+
+    this->num_channels = BENCH_CHANNELS;
+    this->channels = calloc(BENCH_CHANNELS, sizeof(char *));
+    this->bufs = calloc(BENCH_CHANNELS, sizeof(lcm_recv_buf_t));
+
+    uint64_t now = timestamp_now();
+    for(int i = 0; i < BENCH_CHANNELS; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "bench_gen_%05d_t", i % BENCH_TYPES);
+        const lcmtype_metadata_t *md = lcmtype_db_get_using_name(db, name);
+        if(md == NULL) {
+            fprintf(stderr, "ERR: bench lcmtype '%s' not found\n", name);
+            return 1;
+        }
+
+        gen_msg_t msg = { .utime = now - 1000, .value = i };
+        int size = md->typeinfo->encoded_size(&msg);
+        void *data = malloc(size);
+        if(md->typeinfo->encode(data, 0, size, &msg) != size) {
+            fprintf(stderr, "ERR: failed to encode a '%s'\n", name);
+            free(data);
+            return 1;
+        }
+        this->bufs[i].data = data;
+        this->bufs[i].data_size = size;
+
+        snprintf(name, sizeof(name), "BENCH_CHANNEL_%05d", i);
+        this->channels[i] = strdup(name);
+    }
+
+    // every channel exists and has a message: the benchmarks measure the steady state
+    for(int i = 0; i < BENCH_CHANNELS; i++)
+        handler_all_lcm(&this->bufs[i], this->channels[i], provider);
+    view_update_channels(&this->view, spy);
+    return 0;
+}
+
+static void spy_bench_cleanup(spy_bench_t *this)
+{
+    spyinfo_t *spy = &this->spy;
+    for(int i = 0; i < this->num_channels; i++) {
+        free(this->channels[i]);
+        free(this->bufs[i].data);
+    }
+    free(this->channels);
+    free(this->bufs);
+    free(this->view.channels);
+    strbuf_cleanup(&this->out);
+
+    g_ptr_array_free(spy->channels, TRUE);
+    g_hash_table_destroy(this->provider.minfo_hashtbl);
+    pthread_mutex_destroy(&spy->channels_mutex);
+    pthread_mutex_destroy(&spy->ui_mutex);
+    pthread_mutex_destroy(&spy->recorder_mutex);
+    pthread_cond_destroy(&spy->redraw_cond);
+}
+
+/* one message, to the channels in turn */
+static void bench_handler(void *arg, uint64_t iters)
+{
+    spy_bench_t *this = arg;
+    int n = this->num_channels;
+    for(uint64_t i = 0; i < iters; i++)
+        handler_all_lcm(&this->bufs[i % n], this->channels[i % n], &this->provider);
+}
+
+/* what the overview reads per channel and frame */
+static void bench_channel_stats(void *arg, uint64_t iters)
+{
+    spy_bench_t *this = arg;
+    const view_t *view = &this->view;
+    msg_stats_t stats;
+    rate_summary_t rate;
+    uint64_t now = timestamp_now();
+    for(uint64_t i = 0; i < iters; i++) {
+        msg_info_get_stats(view->channels[i % view->num_channels], &stats);
+        rate_stats_get(&stats.rate, now, &rate);
+    }
+}
+
+/* decodes the message of the channels in turn, as the decode screen does */
+static void bench_decode(void *arg, uint64_t iters)
+{
+    spy_bench_t *this = arg;
+    const view_t *view = &this->view;
+    for(uint64_t i = 0; i < iters; i++) {
+        // the view is sorted by channel name, in the same order as 'bufs'
+        int k = i % view->num_channels;
+        msg_info_t *minfo = view->channels[k];
+        msg_info_decode(minfo, minfo->metadata, this->bufs[k].data, this->bufs[k].data_size);
+    }
+}
+
+/* a new channel showed up: the view copies the whole channel list */
+static void bench_view_update(void *arg, uint64_t iters)
+{
+    spy_bench_t *this = arg;
+    for(uint64_t i = 0; i < iters; i++) {
+        this->view.channels_gen--;
+        view_update_channels(&this->view, &this->spy);
+    }
+}
+
+static void bench_overview(void *arg, uint64_t iters)
+{
+    spy_bench_t *this = arg;
+    for(uint64_t i = 0; i < iters; i++) {
+        strbuf_clear(&this->out);
+        display_overview(&this->out, &this->spy, &this->view);
+    }
+}
+
+/* a print thread drawing the overview to a terminal, concurrently with the
+   benchmark thread receiving: the seqlocks and the triple buffers are read
+   while they are written. The terminal is a pipe, drained either as fast
+   as possible or slowly: the receive rate must not depend on it */
+typedef struct
+{
+    spy_bench_t *bench;
+    int is_slow;
+    int fds[2];
+    pthread_t print_thread;
+    pthread_t drain_thread;
+    uint32_t is_stopping;
+    uint64_t num_frames;
+
+} print_stress_t;
+
+static void *stress_print_func(void *arg)
+{
+    print_stress_t *this = arg;
+    spyinfo_t *spy = &this->bench->spy;
+    term_render_t *render = term_render_create(this->fds[1]);
+    view_t view;
+    strbuf_t out;
+    memset(&view, 0, sizeof(view));
+    strbuf_init(&out);
+
+    while(!__atomic_load_n(&this->is_stopping, __ATOMIC_ACQUIRE)) {
+        view_update_channels(&view, spy);
+        strbuf_clear(&out);
+        display_overview(&out, spy, &view);
+
+        // as the decode screen would, on a channel changing while we draw
+        const lcmtype_metadata_t *metadata;
+        msg_info_get_msg(view.channels[this->num_frames % view.num_channels], &metadata);
+
+        // blocks while the terminal is busy
+        term_render_frame(render, out.data, out.len);
+        this->num_frames++;
+    }
+
+    term_render_destroy(render);
+    strbuf_cleanup(&out);
+    free(view.channels);
+    close(this->fds[1]);
+    return NULL;
+}
+
+static void *stress_drain_func(void *arg)
+{
+    print_stress_t *this = arg;
+    char buf[64 * 1024];
+    for(;;) {
+        // once stopping, drain quickly to unblock the print thread
+        int is_slow = this->is_slow && !__atomic_load_n(&this->is_stopping, __ATOMIC_ACQUIRE);
+        ssize_t n = read(this->fds[0], buf, is_slow ? SLOW_TERMINAL_CHUNK : sizeof(buf));
+        if(n == 0 || (n < 0 && errno != EINTR))
+            break;
+        if(is_slow)
+            usleep(SLOW_TERMINAL_PERIOD);
+    }
+    close(this->fds[0]);
+    return NULL;
+}
+
+/* returns the ns per message, 0 when filtered out */
+static double bench_handler_print_thread(spy_bench_t *bench, const char *name, int is_slow)
+{
+    if(!bench_is_selected(name))
+        return 0.0;
+
+    print_stress_t this = { .bench = bench, .is_slow = is_slow, .is_stopping = 0, .num_frames = 0 };
+    if(pipe(this.fds) != 0) {
+        fprintf(stderr, "ERR: failed to create a pipe: %s\n", strerror(errno));
+        return 0.0;
+    }
+    pthread_create(&this.drain_thread, NULL, stress_drain_func, &this);
+    pthread_create(&this.print_thread, NULL, stress_print_func, &this);
+
+    double ns = bench_run(name, bench_handler, bench, 100 * BENCH_CHANNELS);
+
+    __atomic_store_n(&this.is_stopping, 1, __ATOMIC_RELEASE);
+    pthread_join(this.print_thread, NULL);
+    pthread_join(this.drain_thread, NULL);
+    printf("#   %"PRIu64" frames drawn meanwhile\n", this.num_frames);
+    return ns;
+}
+
+/* the lcm thread only hands the messages to the workers, which handle
+   them concurrently: a run ends once they are all handled */
+static void bench_handler_workers(void *arg, uint64_t iters)
+{
+    spy_bench_t *this = arg;
+    bench_handler(this, iters);
+    work_pool_drain(this->provider.pool);
+}
+
+static void bench_workers(spy_bench_t *bench, int num_workers)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "handler_all_lcm/10k_channels/%d_workers", num_workers);
+    if(!bench_is_selected(name))
+        return;
+
+    provider_t *provider = &bench->provider;
+    provider->pool = work_pool_create(num_workers, WORKER_QUEUE_SIZE, -1, handle_msg, &bench->spy);
+    if(provider->pool == NULL) {
+        fprintf(stderr, "ERR: failed to start %d workers\n", num_workers);
+        return;
+    }
+    bench_run(name, bench_handler_workers, bench, 100 * BENCH_CHANNELS);
+    work_pool_destroy(provider->pool);
+    provider->pool = NULL;
+}
+
+/* one message at a time, to workers that went to sleep meanwhile: every
+   submit races with its worker falling asleep. A lost wakeup leaves the
+   message unhandled until WAKEUP_TIMEOUT, and is counted */
+#define WAKEUP_TIMEOUT 1000000  /* usec */
+
+typedef struct
+{
+    work_pool_t *pool;
+    int num_workers;
+    uint64_t num_handled;
+    uint64_t num_lost;
+
+} wakeup_bench_t;
+
+static void count_msg(void *usr, const work_msg_t *msg)
+{
+    wakeup_bench_t *this = usr;
+    __atomic_add_fetch(&this->num_handled, 1, __ATOMIC_RELEASE);
+}
+
+static void bench_wakeup(void *arg, uint64_t iters)
+{
+    wakeup_bench_t *this = arg;
+    for(uint64_t i = 0; i < iters; i++) {
+        uint64_t want = __atomic_load_n(&this->num_handled, __ATOMIC_RELAXED) + 1;
+        work_pool_submit(this->pool, i % this->num_workers, NULL, 0, NULL, 0, 0);
+
+        uint64_t start = timestamp_now();
+        while(__atomic_load_n(&this->num_handled, __ATOMIC_ACQUIRE) < want) {
+            if(timestamp_now() - start > WAKEUP_TIMEOUT) {
+                this->num_lost++;
+                work_pool_drain(this->pool);
+                break;
+            }
+            sched_yield();
+        }
+    }
+}
+
+static void bench_workers_wakeup(int num_workers)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "work_pool_submit/wakeup/%d_workers", num_workers);
+    if(!bench_is_selected(name))
+        return;
+
+    wakeup_bench_t this = { .num_workers = num_workers, .num_handled = 0, .num_lost = 0 };
+    this.pool = work_pool_create(num_workers, 0, -1, count_msg, &this);
+    if(this.pool == NULL) {
+        fprintf(stderr, "ERR: failed to start %d workers\n", num_workers);
+        return;
+    }
+    bench_run(name, bench_wakeup, &this, 10000);
+    work_pool_destroy(this.pool);
+    printf("#   %"PRIu64" lost wakeups\n", this.num_lost);
+}
+
+void bench_spy(lcmtype_db_t *db)
+{
+    // main.c logs to its debug file
+    DEBUG_FILE = fopen("/dev/null", "w");
+
+    spy_bench_t *this = malloc(sizeof(spy_bench_t));
+    if(spy_bench_init(this, db) != 0)
+        goto done;
+
+    bench_run("handler_all_lcm/10k_channels", bench_handler, this, 10 * BENCH_CHANNELS);
+    this->spy.decode_all = 1; /* true */
+    bench_run("handler_all_lcm/10k_channels/decode_all", bench_handler, this, 10 * BENCH_CHANNELS);
+    this->spy.decode_all = 0; /* false */
+    const char *slow_name = "handler_all_lcm/10k_channels/print_thread/slow_terminal";
+    double fast = bench_handler_print_thread(this, "handler_all_lcm/10k_channels/print_thread", 0);
+    double slow = bench_handler_print_thread(this, slow_name, 1);
+    if(fast > 0.0 && slow > SLOW_TERMINAL_MAX_SLOWDOWN * fast) {
+        char why[128];
+        snprintf(why, sizeof(why), "receiving is %.1fx slower than with a fast terminal", slow / fast);
+        bench_fail(slow_name, why);
+    }
+    for(int n = 1; n <= 8; n *= 2)
+        bench_workers(this, n);
+    for(int n = 1; n <= 8; n *= 2)
+        bench_workers_wakeup(n);
+    bench_run("msg_info_get_stats+rate/10k_channels", bench_channel_stats, this, 10 * BENCH_CHANNELS);
+    bench_run("msg_info_decode/arena", bench_decode, this, 10 * BENCH_CHANNELS);
+    this->spy.use_arena = 0; /* false */
+    bench_run("msg_info_decode/generated", bench_decode, this, 10 * BENCH_CHANNELS);
+    this->spy.use_arena = 1; /* true */
+    bench_run("view_update_channels/10k_channels", bench_view_update, this, 100);
+    bench_run("display_overview/10k_channels", bench_overview, this, BENCH_FRAMES);
+
+  done:
+    spy_bench_cleanup(this);
+    free(this);
+    fclose(DEBUG_FILE);
+    DEBUG_FILE = NULL;
+}
@@ -0,0 +1,154 @@
+/* benchmarks of the type library loading, on the generated library
+   (10k types): the ELF symbol scan alone, compared with the byte scanner
+   it replaced, the typename discovery, then lcmtype_db_create() without
+   the type cache and with a warm one. find_all_typenames() is static, so
+   lcmtype_db.c is compiled into this file */
+#include "../lcmtype_db.c"
+
+#include "bench.h"
+#include "../symtab_elf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <unistd.h>
+
+#define BENCH_CACHE_FILENAME "/tmp/spy-lite-bench-typecache"
+#define BENCH_LOADS 10
+
+static void bench_symtab_scan(void *arg, uint64_t iters)
+{
+    const char *lib = arg;
+    for(uint64_t i = 0; i < iters; i++) {
+        symtab_elf_iter_t *stbl = symtab_elf_iter_create(lib);
+        if(stbl == NULL)
+            return;
+        while(symtab_elf_iter_get_next(stbl) != NULL)
+            ;
+        symtab_elf_iter_destroy(stbl);
+    }
+}
+
+/* the baseline: the symbol "scanner" symtab_elf_iter replaced. It reads
+   the whole file through a small buffer and reports every NUL-terminated
+   run of identifier characters, growing each one a character at a time */
+#define BYTESCAN_BUF 256
+
+typedef struct
+{
+    FILE *f;
+    char buffer[BYTESCAN_BUF];
+    int num_read;
+    int index;
+
+    char *s;
+    size_t len;
+    size_t alloc;
+
+} bytescan_iter_t;
+
+static inline void bytescan_append(bytescan_iter_t *this, char c)
+{
+    if(this->len + 1 == this->alloc) {
+        this->alloc *= 2;
+        this->s = realloc(this->s, this->alloc);
+    }
+    this->s[this->len++] = c;
+    this->s[this->len] = '\0';
+}
+
+static inline void bytescan_clear(bytescan_iter_t *this)
+{
+    this->len = 0;
+    this->s[0] = '\0';
+}
+
+static const char *bytescan_get_next(bytescan_iter_t *this)
+{
+    bytescan_clear(this);
+
+    for(;;) {
+        while(this->index < this->num_read) {
+            uint8_t c = this->buffer[this->index++];
+            if(c == '\0') {
+                if(this->len > 0)
+                    return this->s;
+            } else if(this->len > 0 && (isalnum(c) || c == '_')) {
+                bytescan_append(this, c);
+            } else if(this->len == 0 && (isalpha(c) || c == '_')) {
+                bytescan_append(this, c);
+            } else {
+                bytescan_clear(this);
+            }
+        }
+
+        int n = fread(this->buffer, 1, BYTESCAN_BUF, this->f);
+        if(n == 0)
+            return NULL;
+        this->num_read = n;
+        this->index = 0;
+    }
+}
+
+static void bench_bytescan(void *arg, uint64_t iters)
+{
+    const char *lib = arg;
+    for(uint64_t i = 0; i < iters; i++) {
+        bytescan_iter_t it = { .num_read = 0, .index = 0, .len = 0, .alloc = 8 };
+        it.f = fopen(lib, "rb");
+        if(it.f == NULL)
+            return;
+        it.s = malloc(it.alloc);
+        it.s[0] = '\0';
+        while(bytescan_get_next(&it) != NULL)
+            ;
+        fclose(it.f);
+        free(it.s);
+    }
+}
+
+/* the symbol scan, the suffix matching and the candidate set, without
+   dlopen() and dlsym() */
+static void bench_find_typenames(void *arg, uint64_t iters)
+{
+    const char *lib = arg;
+    for(uint64_t i = 0; i < iters; i++) {
+        char **names = find_all_typenames(lib);
+        if(names == NULL)
+            return;
+        for(char **ptr = names; *ptr; ptr++)
+            free(*ptr);
+        free(names);
+    }
+}
+
+static void bench_db_create(void *arg, uint64_t iters, const char *cache_filename)
+{
+    const char *lib = arg;
+    for(uint64_t i = 0; i < iters; i++)
+        lcmtype_db_destroy(lcmtype_db_create(lib, cache_filename, 0));
+}
+
+static void bench_db_create_cold(void *arg, uint64_t iters)
+{
+    bench_db_create(arg, iters, NULL);
+}
+
+static void bench_db_create_warm(void *arg, uint64_t iters)
+{
+    bench_db_create(arg, iters, BENCH_CACHE_FILENAME);
+}
+
+void bench_typedb(const char *lib)
+{
+    bench_run("symtab_elf_iter/scan", bench_symtab_scan, (void *) lib, BENCH_LOADS);
+    bench_run("symtab_elf_iter/scan/old_byte_scanner", bench_bytescan, (void *) lib, BENCH_LOADS);
+    bench_run("find_all_typenames", bench_find_typenames, (void *) lib, BENCH_LOADS);
+    bench_run("lcmtype_db_create/no_cache", bench_db_create_cold, (void *) lib, BENCH_LOADS);
+
+    // the first load writes the cache
+    unlink(BENCH_CACHE_FILENAME);
+    lcmtype_db_destroy(lcmtype_db_create(lib, BENCH_CACHE_FILENAME, 0));
+    bench_run("lcmtype_db_create/warm_cache", bench_db_create_warm, (void *) lib, BENCH_LOADS);
+    unlink(BENCH_CACHE_FILENAME);
+}
@@ -0,0 +1,113 @@
+/* hand-written nested lcmtypes for the msg_display() benchmarks, built
+   into the same library as the generated ones. Only the introspection
+   (get_field, num_fields, struct_size, get_hash) is real: the benchmarks
+   build their messages in memory, nothing is encoded or decoded.
+*/
+#include "bench_nested.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SET_FIELD(f, NAME, TYPE, TYPESTR, DATA) \
+    do { (f)->name = NAME; (f)->type = TYPE; (f)->typestr = TYPESTR; (f)->data = (void *) (DATA); } while(0)
+
+/* the functions every lcmtype needs to be found by lcmtype_db */
+#define DEFINE_LCMTYPE(T, HASH)                                                          \
+    static int64_t T##_hash(void) { return (int64_t) HASH; }                            \
+    int T##_encode(void *buf, int offset, int maxlen, const void *p) { return -1; }      \
+    int T##_decode(const void *buf, int offset, int maxlen, void *p) { return -1; }      \
+    int T##_decode_cleanup(void *p) { return 0; }                                        \
+    int T##_encoded_size(const void *p) { return -1; }                                   \
+    int T##_struct_size(void) { return sizeof(T); }                                      \
+    void *T##_copy(const void *p) { return NULL; }                                       \
+    void T##_destroy(void *p) { }                                                        \
+    int T##_publish(void *lcm, const char *channel, const void *p) { return -1; }        \
+    void *T##_subscribe(void *lcm, const char *channel, void *handler, void *userdata)  \
+        { return NULL; }                                                                 \
+    int T##_subscription_set_queue_capacity(void *sub, int num_messages) { return -1; }  \
+    int T##_unsubscribe(void *lcm, void *sub) { return -1; }                             \
+    const lcm_type_info_t *T##_get_type_info(void)                                       \
+    {                                                                                    \
+        static lcm_type_info_t typeinfo = {                                              \
+            .encode = T##_encode, .decode = T##_decode,                                  \
+            .decode_cleanup = T##_decode_cleanup, .encoded_size = T##_encoded_size,      \
+            .struct_size = T##_struct_size, .num_fields = T##_num_fields,                \
+            .get_field = T##_get_field, .get_hash = T##_hash                             \
+        };                                                                               \
+        return &typeinfo;                                                                \
+    }
+
+int bench_point_t_num_fields(void) { return 4; }
+
+int bench_point_t_get_field(const void *p, int i, lcm_field_t *f)
+{
+    bench_point_t *msg = (bench_point_t *) p;
+    memset(f, 0, sizeof(lcm_field_t));
+    switch(i) {
+        case 0: SET_FIELD(f, "utime", LCM_FIELD_INT64_T, "int64_t", &msg->utime); return 0;
+        case 1: SET_FIELD(f, "x", LCM_FIELD_DOUBLE, "double", &msg->x); return 0;
+        case 2: SET_FIELD(f, "y", LCM_FIELD_DOUBLE, "double", &msg->y); return 0;
+        case 3: SET_FIELD(f, "z", LCM_FIELD_DOUBLE, "double", &msg->z); return 0;
+    }
+    return 1;
+}
+
+DEFINE_LCMTYPE(bench_point_t, 0x1f2e3d4c5b6a7988LL)
+
+int bench_path_t_num_fields(void) { return 7; }
+
+int bench_path_t_get_field(const void *p, int i, lcm_field_t *f)
+{
+    bench_path_t *msg = (bench_path_t *) p;
+    memset(f, 0, sizeof(lcm_field_t));
+    switch(i) {
+        case 0: SET_FIELD(f, "utime", LCM_FIELD_INT64_T, "int64_t", &msg->utime); return 0;
+        case 1: SET_FIELD(f, "frame", LCM_FIELD_STRING, "string", &msg->frame); return 0;
+        case 2: SET_FIELD(f, "origin", LCM_FIELD_USER_TYPE, "bench_point_t", &msg->origin); return 0;
+        case 3: SET_FIELD(f, "num_points", LCM_FIELD_INT32_T, "int32_t", &msg->num_points); return 0;
+        case 4:
+            SET_FIELD(f, "points", LCM_FIELD_USER_TYPE, "bench_point_t", &msg->points);
+            f->num_dim = 1;
+            f->dim_size[0] = msg->num_points;
+            f->dim_is_variable[0] = 1;
+            return 0;
+        case 5:
+            SET_FIELD(f, "cov", LCM_FIELD_DOUBLE, "double", &msg->cov);
+            f->num_dim = 1;
+            f->dim_size[0] = 36;
+            return 0;
+        case 6:
+            SET_FIELD(f, "grid", LCM_FIELD_FLOAT, "float", &msg->grid);
+            f->num_dim = 2;
+            f->dim_size[0] = BENCH_GRID_ROWS;
+            f->dim_size[1] = BENCH_GRID_COLS;
+            return 0;
+    }
+    return 1;
+}
+
+DEFINE_LCMTYPE(bench_path_t, 0x2a3b4c5d6e7f8091LL)
+
+int bench_image_t_num_fields(void) { return 4; }
+
+int bench_image_t_get_field(const void *p, int i, lcm_field_t *f)
+{
+    bench_image_t *msg = (bench_image_t *) p;
+    memset(f, 0, sizeof(lcm_field_t));
+    switch(i) {
+        case 0: SET_FIELD(f, "utime", LCM_FIELD_INT64_T, "int64_t", &msg->utime); return 0;
+        case 1: SET_FIELD(f, "height", LCM_FIELD_INT32_T, "int32_t", &msg->height); return 0;
+        case 2: SET_FIELD(f, "width", LCM_FIELD_INT32_T, "int32_t", &msg->width); return 0;
+        case 3:
+            SET_FIELD(f, "data", LCM_FIELD_BYTE, "byte", &msg->data);
+            f->num_dim = 2;
+            f->dim_size[0] = msg->height;
+            f->dim_size[1] = msg->width;
+            f->dim_is_variable[0] = 1;
+            f->dim_is_variable[1] = 1;
+            return 0;
+    }
+    return 1;
+}
+
+DEFINE_LCMTYPE(bench_image_t, 0x3b4c5d6e7f8091a2LL)
@@ -0,0 +1,57 @@
+#ifndef BENCH_NESTED_H
+#define BENCH_NESTED_H
+
+#include <stdint.h>
+#include <lcm/lcm_coretypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the layouts lcm-gen would emit for:
+     struct bench_point_t { int64_t utime; double x, y, z; }
+     struct bench_path_t  { int64_t utime; string frame; bench_point_t origin;
+                            int32_t num_points; bench_point_t points[num_points];
+                            double cov[36]; float grid[16][16]; }
+     struct bench_image_t { int64_t utime; int32_t height; int32_t width;
+                            byte data[height][width]; }
+*/
+
+#define BENCH_GRID_ROWS 16
+#define BENCH_GRID_COLS 16
+
+typedef struct
+{
+    int64_t utime;
+    double x;
+    double y;
+    double z;
+
+} bench_point_t;
+
+typedef struct
+{
+    int64_t utime;
+    char *frame;
+    bench_point_t origin;
+    int32_t num_points;
+    bench_point_t *points;
+    double cov[36];
+    float grid[BENCH_GRID_ROWS][BENCH_GRID_COLS];
+
+} bench_path_t;
+
+typedef struct
+{
+    int64_t utime;
+    int32_t height;
+    int32_t width;
+    uint8_t **data;
+
+} bench_image_t;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* BENCH_NESTED_H */
@@ -0,0 +1,94 @@
+/* writes the C source of N synthetic lcmtypes to stdout, for the
+   lcmtype_db_create() benchmarks. Each type has every function lcm-gen
+   emits, so the library scans like a real one:
+       bench_gen_00000_t { int64_t utime; double value; }
+*/
+#include <stdio.h>
+#include <stdlib.h>
+
+static const char *prelude =
+    "#include <stdint.h>\n"
+    "#include <stdlib.h>\n"
+    "#include <string.h>\n"
+    "#include <lcm/lcm_coretypes.h>\n"
+    "\n"
+    "typedef struct { int64_t utime; double value; } gen_msg_t;\n"
+    "\n"
+    "static int gen_encode(void *buf, int offset, int maxlen, const void *p, int64_t hash)\n"
+    "{\n"
+    "    const gen_msg_t *msg = p;\n"
+    "    int64_t v[3] = { hash, msg->utime, 0 };\n"
+    "    memcpy(&v[2], &msg->value, sizeof(double));\n"
+    "    if(maxlen < 24) return -1;\n"
+    "    return __int64_t_encode_array(buf, offset, maxlen, v, 3);\n"
+    "}\n"
+    "\n"
+    "static int gen_decode(const void *buf, int offset, int maxlen, void *p, int64_t hash)\n"
+    "{\n"
+    "    gen_msg_t *msg = p;\n"
+    "    int64_t v[3];\n"
+    "    if(__int64_t_decode_array(buf, offset, maxlen, v, 3) < 0 || v[0] != hash) return -1;\n"
+    "    msg->utime = v[1];\n"
+    "    memcpy(&msg->value, &v[2], sizeof(double));\n"
+    "    return 24;\n"
+    "}\n"
+    "\n"
+    "static int gen_get_field(const void *p, int i, lcm_field_t *f)\n"
+    "{\n"
+    "    gen_msg_t *msg = (gen_msg_t *) p;\n"
+    "    memset(f, 0, sizeof(lcm_field_t));\n"
+    "    if(i == 0) { f->name = \"utime\"; f->type = LCM_FIELD_INT64_T; f->typestr = \"int64_t\"; f->data = &msg->utime; return 0; }\n"
+    "    if(i == 1) { f->name = \"value\"; f->type = LCM_FIELD_DOUBLE; f->typestr = \"double\"; f->data = &msg->value; return 0; }\n"
+    "    return 1;\n"
+    "}\n"
+    "\n"
+    "static int gen_decode_cleanup(void *p) { return 0; }\n"
+    "static int gen_encoded_size(const void *p) { return 24; }\n"
+    "static int gen_struct_size(void) { return sizeof(gen_msg_t); }\n"
+    "static int gen_num_fields(void) { return 2; }\n"
+    "\n";
+
+static const char *type_template =
+    "static int64_t %1$s_hash(void) { return (int64_t) 0x%2$016llxLL; }\n"
+    "int %1$s_encode(void *buf, int offset, int maxlen, const void *p) { return gen_encode(buf, offset, maxlen, p, %1$s_hash()); }\n"
+    "int %1$s_decode(const void *buf, int offset, int maxlen, void *p) { return gen_decode(buf, offset, maxlen, p, %1$s_hash()); }\n"
+    "int %1$s_decode_cleanup(void *p) { return 0; }\n"
+    "int %1$s_encoded_size(const void *p) { return 24; }\n"
+    "int %1$s_struct_size(void) { return sizeof(gen_msg_t); }\n"
+    "int %1$s_num_fields(void) { return 2; }\n"
+    "int %1$s_get_field(const void *p, int i, lcm_field_t *f) { return gen_get_field(p, i, f); }\n"
+    "void *%1$s_copy(const void *p) { void *c = malloc(sizeof(gen_msg_t)); memcpy(c, p, sizeof(gen_msg_t)); return c; }\n"
+    "void %1$s_destroy(void *p) { free(p); }\n"
+    "int %1$s_publish(void *lcm, const char *channel, const void *p) { return -1; }\n"
+    "void *%1$s_subscribe(void *lcm, const char *channel, void *handler, void *userdata) { return NULL; }\n"
+    "int %1$s_subscription_set_queue_capacity(void *sub, int num_messages) { return -1; }\n"
+    "int %1$s_unsubscribe(void *lcm, void *sub) { return -1; }\n"
+    "const lcm_type_info_t *%1$s_get_type_info(void)\n"
+    "{\n"
+    "    static lcm_type_info_t typeinfo = {\n"
+    "        .encode = %1$s_encode, .decode = %1$s_decode, .decode_cleanup = gen_decode_cleanup,\n"
+    "        .encoded_size = gen_encoded_size, .struct_size = gen_struct_size,\n"
+    "        .num_fields = gen_num_fields, .get_field = gen_get_field, .get_hash = %1$s_hash\n"
+    "    };\n"
+    "    return &typeinfo;\n"
+    "}\n"
+    "\n";
+
+int main(int argc, char *argv[])
+{
+    int num_types = (argc > 1) ? atoi(argv[1]) : 0;
+    if(num_types <= 0) {
+        fprintf(stderr, "usage: %s NUM_TYPES > lcmtypes.c\n", argv[0]);
+        return 1;
+    }
+
+    fputs(prelude, stdout);
+    for(int i = 0; i < num_types; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "bench_gen_%05d_t", i);
+        unsigned long long hash = 0x5bd0c1a2b3c4d5e6ull ^ ((unsigned long long) (i + 1) * 0x9e3779b97f4a7c15ull);
+        printf(type_template, name, hash);
+    }
+
+    return 0;
+}
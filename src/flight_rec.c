@@ -0,0 +1,300 @@
+#include "flight_rec.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* file layout: one page of header, then the ring of 'data_size' bytes.
+
+   Records are stored at ever increasing 64-bit "virtual" offsets, the
+   ring position being the offset modulo 'data_size'. A record never wraps
+   around the end of the ring: the rest of the lap is skipped instead,
+   marked with a zero word if there is room for one. The valid records
+   are always [tail, head): 'tail' is moved past the records about to be
+   overwritten before writing, 'head' is moved after writing, so a crash
+   at any point leaves a consistent ring behind. For the same reason, a
+   dump can run next to the appends: like a seqlock reader, it copies a
+   chunk of the ring, then checks that 'tail' did not move past it.
+
+   Each record is an lcm log event:
+     u32 sync word, i64 eventnum, i64 timestamp,
+     i32 channel length, i32 data length, channel, data
+   all big-endian
+*/
+
+#define FLIGHT_REC_MAGIC "LCMFREC1"
+#define FLIGHT_REC_HEADER_SIZE 4096
+#define LOG_SYNC 0xEDA1DA01
+#define LOG_HEADER_SIZE (4 + 8 + 8 + 4 + 4)
+
+/* a dump copies the ring out in chunks of this size */
+#define FLIGHT_REC_DUMP_CHUNK (1024 * 1024)
+
+typedef struct
+{
+    char magic[8];
+    uint64_t data_size;
+    uint64_t head;       // virtual offset of the next record
+    uint64_t tail;       // virtual offset of the oldest record
+    uint64_t eventnum;   // of the next record
+    uint64_t dropped;
+
+} flight_rec_header_t;
+
+struct flight_rec
+{
+    int fd;
+    uint8_t *map;
+    size_t mapsz;
+    flight_rec_header_t *hdr;
+    uint8_t *data;
+    uint64_t data_size;
+};
+
+static inline void write_be32(uint8_t *p, uint32_t v)
+{
+    v = __builtin_bswap32(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline void write_be64(uint8_t *p, uint64_t v)
+{
+    v = __builtin_bswap64(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline uint32_t read_be32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return __builtin_bswap32(v);
+}
+
+flight_rec_t *flight_rec_open(const char *filename, uint64_t size)
+{
+    int fd = open(filename, O_RDWR | O_CREAT, 0644);
+    if(fd < 0) {
+        fprintf(stderr, "ERR: failed to open '%s': %s\n", filename, strerror(errno));
+        return NULL;
+    }
+
+    struct stat st;
+    size_t mapsz = FLIGHT_REC_HEADER_SIZE + size;
+    if(fstat(fd, &st) < 0 || (st.st_size != mapsz && ftruncate(fd, mapsz) < 0)) {
+        fprintf(stderr, "ERR: failed to size '%s': %s\n", filename, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, mapsz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(map == MAP_FAILED) {
+        fprintf(stderr, "ERR: failed to map '%s': %s\n", filename, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+
+    flight_rec_t *this = calloc(1, sizeof(flight_rec_t));
+    this->fd = fd;
+    this->map = map;
+    this->mapsz = mapsz;
+    this->hdr = map;
+    this->data = this->map + FLIGHT_REC_HEADER_SIZE;
+    this->data_size = size;
+
+    // keep what a previous run recorded, if it is a ring of the same size
+    flight_rec_header_t *hdr = this->hdr;
+    if(st.st_size != mapsz || memcmp(hdr->magic, FLIGHT_REC_MAGIC, 8) != 0 ||
+       hdr->data_size != size || hdr->tail > hdr->head || hdr->head - hdr->tail > size) {
+        memset(hdr, 0, sizeof(flight_rec_header_t));
+        hdr->data_size = size;
+        memcpy(hdr->magic, FLIGHT_REC_MAGIC, 8);
+    }
+
+    return this;
+}
+
+void flight_rec_close(flight_rec_t *this)
+{
+    if(this == NULL)
+        return;
+
+    munmap(this->map, this->mapsz);
+    close(this->fd);
+    free(this);
+}
+
+// the virtual offset where the lap containing 'v' ends
+static inline uint64_t lap_end(const flight_rec_t *this, uint64_t v)
+{
+    return v - (v % this->data_size) + this->data_size;
+}
+
+// does a record start at virtual offset 'v', or is it the padding at the end of a lap?
+static inline int is_record(const flight_rec_t *this, uint64_t v)
+{
+    uint64_t pos = v % this->data_size;
+    return this->data_size - pos >= LOG_HEADER_SIZE && read_be32(this->data + pos) == LOG_SYNC;
+}
+
+// the size of the record (or lap padding) at virtual offset 'v'
+static uint64_t record_size(const flight_rec_t *this, uint64_t v)
+{
+    if(!is_record(this, v))
+        return lap_end(this, v) - v;
+
+    const uint8_t *p = this->data + v % this->data_size;
+    return LOG_HEADER_SIZE + (uint64_t) read_be32(p + 20) + read_be32(p + 24);
+}
+
+// moves 'tail' past the records overlapping the ring space below virtual offset 'end'
+// the tail stops at the published head: an empty ring is never ahead of it
+static void evict(flight_rec_t *this, uint64_t end)
+{
+    flight_rec_header_t *hdr = this->hdr;
+    uint64_t tail = hdr->tail;
+    while(tail < hdr->head && tail + this->data_size < end)
+        tail += record_size(this, tail);
+    if(tail > hdr->head)
+        tail = hdr->head;
+    __atomic_store_n(&hdr->tail, tail, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void flight_rec_append(flight_rec_t *this, const char *channel, uint32_t channellen,
+                       int64_t utime, const void *data, uint32_t datalen)
+{
+    flight_rec_header_t *hdr = this->hdr;
+    uint64_t size = LOG_HEADER_SIZE + (uint64_t) channellen + datalen;
+    if(size > this->data_size) {
+        hdr->dropped++;
+        return;
+    }
+
+    // records never wrap around: skip the rest of the lap instead. The padding
+    // is published first, the tail then evicts up to the record's lap
+    uint64_t head = hdr->head;
+    if(head + size > lap_end(this, head)) {
+        uint64_t end = lap_end(this, head);
+        evict(this, end);
+        if(end - head >= 4)
+            write_be32(this->data + head % this->data_size, 0);
+        __atomic_store_n(&hdr->head, end, __ATOMIC_RELEASE);
+        head = end;
+    }
+
+    // evict the oldest records overlapping the space we need
+    evict(this, head + size);
+
+    uint8_t *p = this->data + head % this->data_size;
+    write_be32(p, LOG_SYNC);
+    write_be64(p + 4, hdr->eventnum++);
+    write_be64(p + 12, utime);
+    write_be32(p + 20, channellen);
+    write_be32(p + 24, datalen);
+    memcpy(p + LOG_HEADER_SIZE, channel, channellen);
+    memcpy(p + LOG_HEADER_SIZE + channellen, data, datalen);
+
+    __atomic_store_n(&hdr->head, head + size, __ATOMIC_RELEASE);
+}
+
+static int write_all(int fd, const uint8_t *p, size_t n)
+{
+    while(n > 0) {
+        ssize_t ret = write(fd, p, n);
+        if(ret < 0) {
+            if(errno == EINTR)
+                continue;
+            return 1;
+        }
+        p += ret;
+        n -= ret;
+    }
+    return 0;
+}
+
+int64_t flight_rec_dump(flight_rec_t *this, const char *filename)
+{
+    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) {
+        fprintf(stderr, "ERR: failed to create '%s': %s\n", filename, strerror(errno));
+        return -1;
+    }
+
+    size_t bufsz = FLIGHT_REC_DUMP_CHUNK;
+    uint8_t *buf = malloc(bufsz);
+
+    // the messages recorded so far, those appended meanwhile are left out
+    uint64_t head = __atomic_load_n(&this->hdr->head, __ATOMIC_ACQUIRE);
+    uint64_t v = __atomic_load_n(&this->hdr->tail, __ATOMIC_ACQUIRE);
+    int64_t num_events = 0;
+    int err = 0;
+    while(v < head && !err) {
+        // copy a chunk of the lap, it must not have been overwritten meanwhile
+        uint64_t end = lap_end(this, v);
+        if(end > head)
+            end = head;
+        size_t n = (end - v < bufsz) ? end - v : bufsz;
+        memcpy(buf, this->data + v % this->data_size, n);
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        uint64_t tail = __atomic_load_n(&this->hdr->tail, __ATOMIC_RELAXED);
+        if(tail > v) {
+            // the oldest messages were overwritten while we were at them
+            v = tail;
+            continue;
+        }
+
+        // the records are already in log format: write the complete ones
+        size_t len = 0;
+        uint64_t recsz = 0;
+        while(len + LOG_HEADER_SIZE <= n && read_be32(buf + len) == LOG_SYNC) {
+            recsz = LOG_HEADER_SIZE + (uint64_t) read_be32(buf + len + 20) +
+                read_be32(buf + len + 24);
+            if(len + recsz > n)
+                break;
+            len += recsz;
+            num_events++;
+        }
+
+        if(len > 0) {
+            err = write_all(fd, buf, len);
+            v += len;
+        } else if(n < LOG_HEADER_SIZE || read_be32(buf) != LOG_SYNC) {
+            v = lap_end(this, v);  // the padding at the end of the lap
+        } else if(recsz <= end - v) {
+            // a record bigger than the buffer
+            free(buf);
+            bufsz = recsz;
+            buf = malloc(bufsz);
+        } else {
+            break;  // corrupted
+        }
+    }
+    free(buf);
+
+    if(close(fd) < 0)
+        err = 1;
+    if(err) {
+        fprintf(stderr, "ERR: failed to write '%s': %s\n", filename, strerror(errno));
+        return -1;
+    }
+    return num_events;
+}
+
+uint64_t flight_rec_used(const flight_rec_t *this)
+{
+    // the tail first: it never passes the head, which only grows meanwhile
+    uint64_t tail = __atomic_load_n(&this->hdr->tail, __ATOMIC_ACQUIRE);
+    uint64_t head = __atomic_load_n(&this->hdr->head, __ATOMIC_ACQUIRE);
+    return head - tail;
+}
+
+uint64_t flight_rec_dropped(const flight_rec_t *this)
+{
+    return this->hdr->dropped;
+}
@@ -0,0 +1,42 @@
+#ifndef FLIGHT_REC_H
+#define FLIGHT_REC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* a flight recorder: raw messages are appended to a fixed-size ring in a
+   memory-mapped file, already in the lcm log event format. When the ring
+   is full, the oldest messages are overwritten. Since the mapping is
+   shared with the file, the recording survives a crash of the process
+   (not of the machine) and is picked up again by the next open.
+
+   Only one thread may append at a time. A dump may run in another thread
+   meanwhile: the messages overwritten while it runs are left out of it.
+*/
+
+typedef struct flight_rec flight_rec_t;
+
+// opens (or creates) the ring file, keeping its contents if it has 'size' bytes of data
+flight_rec_t *flight_rec_open(const char *filename, uint64_t size);
+void flight_rec_close(flight_rec_t *this);
+
+void flight_rec_append(flight_rec_t *this, const char *channel, uint32_t channellen,
+                       int64_t utime, const void *data, uint32_t datalen);
+
+// writes the recorded messages, oldest first, as an lcm log file
+// returns the number of events written, or -1 on error
+int64_t flight_rec_dump(flight_rec_t *this, const char *filename);
+
+// the bytes of messages currently held, and the messages too large to ever fit
+uint64_t flight_rec_used(const flight_rec_t *this);
+uint64_t flight_rec_dropped(const flight_rec_t *this);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* FLIGHT_REC_H */
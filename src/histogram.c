@@ -0,0 +1,60 @@
+#include "histogram.h"
+
+#include <string.h>
+
+void histogram_init(histogram_t *this)
+{
+    memset(this->counts, 0, sizeof(this->counts));
+    this->total = 0;
+    this->min = 0;
+    this->max = 0;
+}
+
+static uint64_t bucket_middle(int i)
+{
+    if(i < 2 * HISTOGRAM_SUB_COUNT)
+        return i;
+
+    int shift = i / HISTOGRAM_SUB_COUNT - 1;
+    uint64_t low = (uint64_t) (i % HISTOGRAM_SUB_COUNT + HISTOGRAM_SUB_COUNT) << shift;
+    return low + ((1ull << shift) >> 1);
+}
+
+uint64_t histogram_percentile(const histogram_t *this, double percent)
+{
+    if(this->total == 0)
+        return 0;
+    if(percent <= 0.0)
+        return this->min;
+    if(percent >= 100.0)
+        return this->max;
+
+    // the rank of the value, 1-based
+    uint64_t rank = (uint64_t) (percent / 100.0 * this->total + 0.5);
+    if(rank == 0)
+        rank = 1;
+
+    uint64_t seen = 0;
+    for(int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += this->counts[i];
+        if(seen >= rank) {
+            // the bucket may be wider than the values that actually fell in it
+            uint64_t v = bucket_middle(i);
+            if(v < this->min) v = this->min;
+            if(v > this->max) v = this->max;
+            return v;
+        }
+    }
+    return this->max;
+}
+
+uint64_t histogram_count_above(const histogram_t *this, uint64_t value)
+{
+    if(value >= this->max)
+        return 0;
+
+    uint64_t count = 0;
+    for(int i = histogram_bucket(value) + 1; i < HISTOGRAM_BUCKETS; i++)
+        count += this->counts[i];
+    return count;
+}
@@ -0,0 +1,66 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* a fixed-memory log-linear histogram of non-negative integers (HDR style)
+   Values below 2^(HISTOGRAM_SUB_BITS+1) are counted exactly, above that
+   every power of two is split into 2^HISTOGRAM_SUB_BITS linear buckets,
+   so a bucket is never wider than 1/16th of its values (~3% error on
+   percentiles). Adding a value is O(1): a count-leading-zeros and an
+   increment. Values of 2^HISTOGRAM_MAX_BITS and more are clamped.
+*/
+
+#define HISTOGRAM_SUB_BITS  4
+#define HISTOGRAM_SUB_COUNT (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_MAX_BITS  36  /* ~19 hours in usec */
+#define HISTOGRAM_BUCKETS   ((HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_COUNT)
+
+typedef struct
+{
+    uint32_t counts[HISTOGRAM_BUCKETS];
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+
+} histogram_t;
+
+void histogram_init(histogram_t *this);
+
+static inline int histogram_bucket(uint64_t value)
+{
+    if(value < 2 * HISTOGRAM_SUB_COUNT)
+        return (int) value;
+    if(value >> HISTOGRAM_MAX_BITS)
+        return HISTOGRAM_BUCKETS - 1;
+
+    int shift = (63 - __builtin_clzll(value)) - HISTOGRAM_SUB_BITS;
+    return (shift + 1) * HISTOGRAM_SUB_COUNT + (int) (value >> shift) - HISTOGRAM_SUB_COUNT;
+}
+
+static inline void histogram_add(histogram_t *this, uint64_t value)
+{
+    this->counts[histogram_bucket(value)]++;
+    if(this->total == 0 || value < this->min)
+        this->min = value;
+    if(value > this->max)
+        this->max = value;
+    this->total++;
+}
+
+// the value below which 'percent' of the values fall, 0 when empty
+// exact for min (0) and max (100), otherwise the middle of a bucket
+uint64_t histogram_percentile(const histogram_t *this, double percent);
+
+// the number of values in the buckets entirely above 'value'
+uint64_t histogram_count_above(const histogram_t *this, uint64_t value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* HISTOGRAM_H */
@@ -0,0 +1,267 @@
+#include "lcm_log_reader.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* every event is:
+     u32 sync word, i64 eventnum, i64 timestamp,
+     i32 channel length, i32 data length, channel, data
+   all big-endian */
+#define LOG_SYNC 0xEDA1DA01
+#define LOG_HEADER_SIZE (4 + 8 + 8 + 4 + 4)
+
+/* release the pages behind the cursor in chunks of this size */
+#define LOG_RELEASE_CHUNK (64 * 1024 * 1024)
+
+/* when the whole log can't be mapped (e.g. the address space of a 32-bit
+   system), it is mapped in windows of this size, moved along the cursor */
+#define LOG_WINDOW_SIZE (64 * 1024 * 1024)
+
+struct lcm_log_reader
+{
+    int fd;           // only kept open when windowed
+    int is_windowed;
+    uint64_t filesz;
+
+    uint8_t *map;
+    uint64_t mapoff;  // file offset of map[0]
+    size_t mapsz;
+
+    uint64_t pos;     // file offset of the cursor
+    uint64_t released;  // everything before this was madvise()'d away
+    size_t pagesz;
+    uint64_t skipped;
+};
+
+static inline uint32_t read_be32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return __builtin_bswap32(v);
+}
+
+static inline uint64_t read_be64(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return __builtin_bswap64(v);
+}
+
+lcm_log_reader_t *lcm_log_reader_open(const char *filename)
+{
+    int fd = open(filename, O_RDONLY);
+    if(fd < 0) {
+        fprintf(stderr, "ERR: failed to open '%s': %s\n", filename, strerror(errno));
+        return NULL;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) < 0) {
+        fprintf(stderr, "ERR: failed to stat '%s': %s\n", filename, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+
+    lcm_log_reader_t *this = calloc(1, sizeof(lcm_log_reader_t));
+    this->fd = -1;
+    this->filesz = st.st_size;
+    this->pagesz = sysconf(_SC_PAGESIZE);
+
+    if(st.st_size > 0 && (uint64_t) st.st_size <= SIZE_MAX) {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(map != MAP_FAILED) {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            this->map = map;
+            this->mapsz = st.st_size;
+        }
+    }
+
+    if(this->map == NULL && st.st_size > 0) {
+        // not enough address space: slide a window along instead
+        this->is_windowed = 1;
+        this->fd = fd;
+        return this;
+    }
+
+    close(fd);
+    return this;
+}
+
+void lcm_log_reader_close(lcm_log_reader_t *this)
+{
+    if(this == NULL)
+        return;
+
+    if(this->map != NULL)
+        munmap(this->map, this->mapsz);
+    if(this->fd >= 0)
+        close(this->fd);
+    free(this);
+}
+
+/* returns the address of the 'len' bytes at file offset 'off', moving
+   the window if needed, or NULL if they can't be mapped */
+static const uint8_t *map_range(lcm_log_reader_t *this, uint64_t off, uint64_t len)
+{
+    if(off >= this->mapoff && off + len <= this->mapoff + this->mapsz)
+        return this->map + (off - this->mapoff);
+    if(!this->is_windowed || off + len > this->filesz)
+        return NULL;
+
+    uint64_t start = off & ~(uint64_t) (this->pagesz - 1);
+    uint64_t end = start + LOG_WINDOW_SIZE;
+    if(end < off + len)
+        end = off + len;  // an event bigger than the window
+    if(end > this->filesz)
+        end = this->filesz;
+    if(end - start > SIZE_MAX)
+        return NULL;
+
+    if(this->map != NULL) {
+        munmap(this->map, this->mapsz);
+        this->map = NULL;
+        this->mapsz = 0;
+    }
+
+    void *map = mmap(NULL, end - start, PROT_READ, MAP_PRIVATE, this->fd, start);
+    if(map == MAP_FAILED) {
+        fprintf(stderr, "ERR: failed to map %"PRIu64" bytes of the log at offset %"PRIu64": %s\n",
+                end - start, start, strerror(errno));
+        return NULL;
+    }
+    madvise(map, end - start, MADV_SEQUENTIAL);
+
+    this->map = map;
+    this->mapoff = start;
+    this->mapsz = end - start;
+    return this->map + (off - start);
+}
+
+// the end of the current mapping, as a file offset
+static inline uint64_t map_end(const lcm_log_reader_t *this)
+{
+    return this->mapoff + this->mapsz;
+}
+
+// gives up on the rest of the log
+static void skip_to_end(lcm_log_reader_t *this)
+{
+    if(this->pos < this->filesz) {
+        this->skipped += this->filesz - this->pos;
+        this->pos = this->filesz;
+    }
+}
+
+// scan forward to the next sync word, returns 0 if there is none
+static int resync(lcm_log_reader_t *this)
+{
+    static const uint8_t sync[4] = { 0xED, 0xA1, 0xDA, 0x01 };
+
+    uint64_t start = this->pos;
+    while(this->pos + 4 <= this->filesz) {
+        // the rest of the current window (a sync word may straddle its end)
+        if(map_range(this, this->pos, 4) == NULL)
+            break;
+        const uint8_t *base = this->map + (this->pos - this->mapoff);
+        const uint8_t *p = memchr(base, sync[0], map_end(this) - this->pos);
+        if(p == NULL) {
+            this->pos = map_end(this);
+            continue;
+        }
+        this->pos += p - base;
+
+        const uint8_t *word = map_range(this, this->pos, 4);
+        if(word == NULL)
+            break;
+        if(memcmp(word, sync, 4) == 0) {
+            this->skipped += this->pos - start;
+            return 1;
+        }
+        this->pos++;
+    }
+
+    this->skipped += this->pos - start;
+    skip_to_end(this);
+    return 0;
+}
+
+// the current event stays mapped: only pages before the cursor are released
+static void release_behind(lcm_log_reader_t *this)
+{
+    if(this->is_windowed)
+        return;  // the windows are unmapped as they move on
+
+    uint64_t end = this->pos & ~(uint64_t) (this->pagesz - 1);
+    if(end - this->released < LOG_RELEASE_CHUNK)
+        return;
+
+    madvise(this->map + this->released, end - this->released, MADV_DONTNEED);
+    this->released = end;
+}
+
+int lcm_log_reader_next(lcm_log_reader_t *this, lcm_log_event_t *ev)
+{
+    while(this->pos + LOG_HEADER_SIZE <= this->filesz) {
+        const uint8_t *p = map_range(this, this->pos, LOG_HEADER_SIZE);
+        if(p == NULL)
+            break;
+
+        if(read_be32(p) != LOG_SYNC) {
+            if(!resync(this))
+                return 0;
+            continue;
+        }
+
+        int32_t channellen = read_be32(p + 20);
+        int32_t datalen = read_be32(p + 24);
+        uint64_t left = this->filesz - this->pos - LOG_HEADER_SIZE;
+        if(channellen <= 0 || datalen < 0 || (uint64_t) channellen + datalen > left) {
+            // not a real event (or a truncated last one): skip its sync word
+            this->pos++;
+            if(!resync(this))
+                return 0;
+            continue;
+        }
+
+        p = map_range(this, this->pos, LOG_HEADER_SIZE + (uint64_t) channellen + datalen);
+        if(p == NULL)
+            break;
+
+        ev->eventnum = read_be64(p + 4);
+        ev->timestamp = read_be64(p + 12);
+        ev->channel = (const char *) p + LOG_HEADER_SIZE;
+        ev->channellen = channellen;
+        ev->data = p + LOG_HEADER_SIZE + channellen;
+        ev->datalen = datalen;
+
+        release_behind(this);
+        this->pos += LOG_HEADER_SIZE + channellen + datalen;
+        return 1;
+    }
+
+    skip_to_end(this);
+    return 0;
+}
+
+int lcm_log_reader_is_stable(const lcm_log_reader_t *this)
+{
+    return !this->is_windowed;
+}
+
+uint64_t lcm_log_reader_size(const lcm_log_reader_t *this)
+{
+    return this->filesz;
+}
+
+uint64_t lcm_log_reader_skipped(const lcm_log_reader_t *this)
+{
+    return this->skipped;
+}
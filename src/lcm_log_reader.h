@@ -0,0 +1,50 @@
+#ifndef LCM_LOG_READER_H
+#define LCM_LOG_READER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* a zero-copy reader for lcm event log files. The whole file is mapped,
+   events point straight into the mapping and are only valid until the
+   reader is closed. Pages already read are released as the reader moves
+   on, so even huge logs do not pile up in memory.
+   If the file doesn't fit in the address space (e.g. a large log on a
+   32-bit system), it is mapped in windows instead, and an event is then
+   only valid until the next call to lcm_log_reader_next().
+*/
+
+typedef struct
+{
+    int64_t eventnum;
+    int64_t timestamp;   // usec
+    const char *channel; // NOT nul-terminated
+    int32_t channellen;
+    const uint8_t *data;
+    int32_t datalen;
+
+} lcm_log_event_t;
+
+typedef struct lcm_log_reader lcm_log_reader_t;
+
+lcm_log_reader_t *lcm_log_reader_open(const char *filename);
+void lcm_log_reader_close(lcm_log_reader_t *this);
+
+// returns 1 and fills in 'ev', or 0 at the end of the log
+int lcm_log_reader_next(lcm_log_reader_t *this, lcm_log_event_t *ev);
+
+// non-zero if events stay valid until the reader is closed, see above
+int lcm_log_reader_is_stable(const lcm_log_reader_t *this);
+
+uint64_t lcm_log_reader_size(const lcm_log_reader_t *this);
+// bytes skipped over while looking for the next event after corrupted data
+uint64_t lcm_log_reader_skipped(const lcm_log_reader_t *this);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* LCM_LOG_READER_H */
@@ -1,5 +1,6 @@
 #include "lcmtype_db.h"
 #include "symtab_elf.h"
+#include "typecache.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -7,7 +8,9 @@
 #include <string.h>
 #include <assert.h>
 #include <dlfcn.h>
+#include <pthread.h>
 #include <glib.h>
+#include <sys/stat.h>
 
 #define MAXBUFSZ 256
 
@@ -62,6 +65,7 @@ struct lcmtype_db
 
 void lcmtype_metadata_destroy(lcmtype_metadata_t *md)
 {
+    free(md->fields);
     free(md->typename);
     free(md);
 }
@@ -110,23 +114,66 @@ static const char *lcmtype_functions[] =
     "_t_unsubscribe"
 };
 
+#define NUM_LCMTYPE_FUNCTIONS (sizeof(lcmtype_functions) / sizeof(const char *))
+
 static void print_missing_methods(int mask)
 {
     printf("  Missing methods:\n");
 
-    int count = sizeof(lcmtype_functions) / sizeof(const char *);
-    for(int i = 0; i < count; i++) {
+    for(int i = 0; i < NUM_LCMTYPE_FUNCTIONS; i++) {
         if(!(mask&(1<<i))) {
             printf("    %s\n", lcmtype_functions[i]);
         }
     }
 }
 
+// suffix matcher: for each possible last character of a symbol, the
+// bitmask of the lcmtype_functions ending with that character
+static uint32_t suffix_by_last_char[256];
+static size_t lcmtype_functions_sz[NUM_LCMTYPE_FUNCTIONS];
+static pthread_once_t suffix_matcher_once = PTHREAD_ONCE_INIT;
+
+static void suffix_matcher_init(void)
+{
+    for(int i = 0; i < NUM_LCMTYPE_FUNCTIONS; i++) {
+        size_t len = strlen(lcmtype_functions[i]);
+        lcmtype_functions_sz[i] = len;
+        suffix_by_last_char[(uint8_t) lcmtype_functions[i][len-1]] |= 1u << i;
+    }
+}
+
+// returns the index of the lcmtype_functions suffix of 's', or -1
+// (no lcm function name is a suffix of another, so the match is unique)
+static inline int match_lcmtype_suffix(const char *s, size_t len)
+{
+    if(len == 0)
+        return -1;
+
+    uint32_t candidates = suffix_by_last_char[(uint8_t) s[len-1]];
+    while(candidates) {
+        int i = __builtin_ctz(candidates);
+        candidates &= candidates - 1;
+
+        size_t flen = lcmtype_functions_sz[i];
+        if(flen <= len && memcmp(s + (len-flen), lcmtype_functions[i], flen) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+static int names_cmp(const void *a, const void *b)
+{
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
 // find all lcm types by post-processing the symbols
 // extracted from the ELF file's symbol table
 // caller is responsible for free'ing the array and its strings
 static char **find_all_typenames(const char *libname)
 {
+    pthread_once(&suffix_matcher_once, suffix_matcher_init);
+
     // read the library's symbol table
     symtab_elf_iter_t *stbl = symtab_elf_iter_create(libname);
     if(stbl == NULL) {
@@ -134,19 +181,11 @@ static char **find_all_typenames(const char *libname)
         return NULL;
     }
 
-    // cache the string lengths
-    int num_required_func = sizeof(lcmtype_functions) / sizeof(const char *);
-    size_t *lcmtype_functions_sz = malloc(num_required_func * sizeof(size_t));
-    for(int i = 0; i < num_required_func; i++)
-        lcmtype_functions_sz[i] = strlen(lcmtype_functions[i]);
-
-    // TODO use a hashtable instead of a O(n) search time unordered array
-    size_t alloc = 4;
-    size_t used = 0;
-    char **names = malloc(alloc * sizeof(char *));
-    int *masks = malloc(alloc * sizeof(int));
+    // candidate typename -> mask of the lcmtype_functions seen for it
+    GHashTable *candidates = g_hash_table_new_full(g_str_hash, g_str_equal, free, NULL);
 
     // process the symbols
+    char typename[MAXBUFSZ];
     while(1) {
         const char *s = symtab_elf_iter_get_next(stbl);
         if(s == NULL)
@@ -155,84 +194,111 @@ static char **find_all_typenames(const char *libname)
         //printf("Symbol: '%s'\n", s);
 
         size_t len = strlen(s);
+        int i = match_lcmtype_suffix(s, len);
+        if(i < 0)
+            continue;
 
-        for(int i = 0; i < num_required_func; i++) {
-            const char *f = lcmtype_functions[i];
-            size_t flen = lcmtype_functions_sz[i];
-
-            if(flen > len)
-                continue;
-
-            // did we find a potential lcmtype?
-            if(strcmp(s + (len-flen), f) == 0) {
-
-                // construct the typename
-                char *typename = strdup(s);
-                typename[len-flen+2] = '\0';
-                if(DEBUG) printf("found potential typename='%s'\n", typename);
-
-                // have we seen this candidate before?
-                // TODO use a hashtable here
-                int j = 0;
-                for(; j < used; j++)
-                    if(strcmp(typename, names[j]) == 0)
-                        break;
-
-                // not found?
-                if(j == used) {
-
-                    // need to realloc ?
-                    if(used+1 >= alloc) {
-                        alloc *= 2;
-                        names = realloc(names, alloc * sizeof(char *));
-                        masks = realloc(masks, alloc * sizeof(int));
-                    }
-
-                    // initialize new candidate
-                    names[used] = typename;
-                    masks[used] = 0;
-                    used++;
-                }
-
-                // we've added this before, cleanup the string copy
-                else {
-                    free(typename);
-                }
-
-                // set this mask
-                masks[j] |= 1<<i;
-
-                break;
-            }
+        // construct the typename (too long names could not be dlsym'ed anyway)
+        size_t tlen = len - lcmtype_functions_sz[i] + 2;
+        if(tlen >= MAXBUFSZ)
+            continue;
+        memcpy(typename, s, tlen);
+        typename[tlen] = '\0';
+        if(DEBUG) printf("found potential typename='%s'\n", typename);
+
+        // have we seen this candidate before?
+        gpointer key, value;
+        if(g_hash_table_lookup_extended(candidates, typename, &key, &value)) {
+            g_hash_table_insert(candidates, key, GINT_TO_POINTER(GPOINTER_TO_INT(value) | (1<<i)));
+        } else {
+            g_hash_table_insert(candidates, strdup(typename), GINT_TO_POINTER(1<<i));
         }
     }
 
-    // prune the names array using the masks
-    int valid_mask = (1 << num_required_func) - 1;
-    int j = 0;
-    for(int i = 0; i < used; i++) {
-        if(masks[i] == valid_mask) {
-            if(DEBUG) printf("verified new lcmtype: %s\n", names[i]);
-            names[j++] = names[i];
+    symtab_elf_iter_destroy(stbl);
+
+    // keep the candidates that have all the lcmtype functions
+    int valid_mask = (1 << NUM_LCMTYPE_FUNCTIONS) - 1;
+    size_t used = 0;
+    char **names = malloc((g_hash_table_size(candidates) + 1) * sizeof(char *));
+
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, candidates);
+    while(g_hash_table_iter_next(&iter, &key, &value)) {
+        int mask = GPOINTER_TO_INT(value);
+        if(mask == valid_mask) {
+            if(DEBUG) printf("verified new lcmtype: %s\n", (char *) key);
+            names[used++] = strdup(key);
         } else {
-            if(DEBUG) printf("rejecting type '%s' with mask 0x%x\n", names[i], masks[i]);
-            if(DEBUG) print_missing_methods(masks[i]);
+            if(DEBUG) printf("rejecting type '%s' with mask 0x%x\n", (char *) key, mask);
+            if(DEBUG) print_missing_methods(mask);
         }
     }
 
+    // sorted, so the load order doesn't depend on the hashtable
+    qsort(names, used, sizeof(char *), names_cmp);
+
     // add NULL sentinel
-    names[j] = NULL;
+    names[used] = NULL;
 
     // cleanup
-    free(lcmtype_functions_sz);
-    free(masks);
+    g_hash_table_destroy(candidates);
 
     // user must free the names array and its strings
     return names;
 }
 
-static int load_types(const char *libname, void *lib,
-                      GHashTable *hash_to_type, GHashTable *name_to_hash)
+// a library scanned and resolved by its own worker thread
+typedef struct
+{
+    const char *libname;
+    typecache_t *cache;  // read-only while the workers run, may be NULL
+    pthread_t thread;
+    int has_thread;
+
+    struct stat st;
+    int has_stat;
+    int from_cache;
+
+    int ret;
+    GPtrArray *types;  // lcmtype_metadata_t's in typename order
+
+} lib_job_t;
+
+// resolve a type from its name, returns NULL on failure
+// on success, the metadata takes ownership of 'typename'
+static lcmtype_metadata_t *resolve_type(void *lib, char *typename)
+{
+    if(DEBUG) printf("Attempting load for type %s\n", typename);
+
+    char funcname[MAXBUFSZ];
+    int n = snprintf(funcname, MAXBUFSZ, "%s_get_type_info", typename);
+    if(n >= MAXBUFSZ) {
+        fprintf(stderr, "ERR: get_type_info function name too long for %s\n", typename);
+        return NULL;
+    }
+
+    lcm_type_info_t *(*get_type_info)(void) = NULL;
+    *(void **) &get_type_info = dlsym(lib, funcname);
+    if(get_type_info == NULL) {
+        fprintf(stderr, "ERR: failed to load %s\n", funcname);
+        return NULL;
+    }
+
+    lcm_type_info_t *typeinfo = get_type_info();
+    int64_t msghash = typeinfo->get_hash();
+    lcmtype_metadata_t *metadata = malloc(sizeof(lcmtype_metadata_t));
+    metadata->hash = msghash;
+    metadata->typename = typename; /* metadata->typename now "owns" the string */
+    metadata->typeinfo = typeinfo;
+    metadata->fields = NULL;
+
+    if(DEBUG) printf("Success loading type %s (0x%"PRIx64")\n", typename, msghash);
+    return metadata;
+}
+
+static int load_types(const char *libname, void *lib, GPtrArray *types)
 {
     char **names = find_all_typenames(libname);
     if(names == NULL) {
@@ -240,45 +306,128 @@ static int load_types(const char *libname, void *lib,
         return 1;
     }
 
-    // fetch each lcmtype_methods_t*, compute each hash, and add to hashtable
+    // fetch each lcmtype_methods_t* and compute each hash
     int count = 0;
     for(char **ptr = names; *ptr; ptr++) {
-        if(DEBUG) printf("Attempting load for type %s\n", *ptr);
-
-        char funcname[MAXBUFSZ];
-        int n = snprintf(funcname, MAXBUFSZ, "%s_get_type_info", *ptr);
-        if(n == MAXBUFSZ) {
-            fprintf(stderr, "ERR: get_type_info function name too long for %s\n", *ptr);
+        lcmtype_metadata_t *metadata = resolve_type(lib, *ptr);
+        if(metadata == NULL) {
+            free(*ptr);
             continue;
         }
+        g_ptr_array_add(types, metadata);
+        count++;
+    }
 
-        lcm_type_info_t *(*get_type_info)(void) = NULL;
-        *(void **) &get_type_info = dlsym(lib, funcname);
-        if(get_type_info == NULL) {
-            fprintf(stderr, "ERR: failed to load %s\n", funcname);
-            continue;
+    if(DEBUG) printf("Loaded %d lcmtypes from %s\n", count, libname);
+
+    // cleanup
+    free(names);
+
+    return 0;
+}
+
+// warm start: only resolve the typenames listed in the cache
+// returns success (0) or failure (1) if the cache entry doesn't match the library
+static int load_cached_types(void *lib, int count, char * const *names,
+                             const int64_t *hashes, GPtrArray *types)
+{
+    for(int i = 0; i < count; i++) {
+        lcmtype_metadata_t *metadata = resolve_type(lib, strdup(names[i]));
+        if(metadata == NULL)
+            return 1;
+
+        g_ptr_array_add(types, metadata);
+        if(metadata->hash != hashes[i])
+            return 1;
+    }
+
+    if(DEBUG) printf("Loaded %d cached lcmtypes\n", count);
+    return 0;
+}
+
+static void *lib_job_thread_func(void *arg)
+{
+    lib_job_t *job = (lib_job_t *) arg;
+
+    if(DEBUG) printf("Loading types from '%s'\n", job->libname);
+    void *lib = open_lib(job->libname);
+    if(lib == NULL) {
+        fprintf(stderr, "Err: failed to open '%s'\n", job->libname);
+        job->ret = 1;
+        return NULL;
+    }
+
+    job->has_stat = (stat(job->libname, &job->st) == 0);
+    if(job->cache != NULL && job->has_stat) {
+        char * const *names;
+        const int64_t *hashes;
+        int count = typecache_lookup(job->cache, job->libname, &job->st, &names, &hashes);
+        if(count >= 0) {
+            if(load_cached_types(lib, count, names, hashes, job->types) == 0) {
+                job->from_cache = 1; /* true */
+                job->ret = 0;
+                return NULL;
+            }
+
+            // the library changed without its stat changing: do a full scan
+            if(DEBUG) printf("Stale type cache entry for '%s'\n", job->libname);
+            for(size_t i = 0; i < job->types->len; i++)
+                lcmtype_metadata_destroy(g_ptr_array_index(job->types, i));
+            g_ptr_array_set_size(job->types, 0);
         }
+    }
 
-        lcm_type_info_t *typeinfo = get_type_info();
-        int64_t msghash = typeinfo->get_hash();
-        lcmtype_metadata_t *metadata = malloc(sizeof(lcmtype_metadata_t));
-        metadata->hash = msghash;
-        metadata->typename = *ptr; /* metadata->typename now "owns" the string */
-        metadata->typeinfo = typeinfo;
+    job->ret = load_types(job->libname, lib, job->types);
+    if(job->ret != 0)
+        fprintf(stderr, "Err: failed to load types from '%s'\n", job->libname);
 
-        g_hash_table_insert(hash_to_type, &metadata->hash, metadata);
-        g_hash_table_insert(name_to_hash, metadata->typename, &metadata->hash);
+    return NULL;
+}
 
-        if(DEBUG) printf("Success loading type %s (0x%"PRIx64")\n", *ptr, msghash);
-        count++;
+// record a freshly scanned library in the cache
+static void cache_types(typecache_t *cache, lib_job_t *job)
+{
+    if(cache == NULL || job->from_cache || job->ret != 0 || !job->has_stat)
+        return;
+
+    int count = job->types->len;
+    char **names = malloc((count + 1) * sizeof(char *));
+    int64_t *hashes = malloc((count + 1) * sizeof(int64_t));
+    for(int i = 0; i < count; i++) {
+        const lcmtype_metadata_t *md = g_ptr_array_index(job->types, i);
+        names[i] = md->typename;
+        hashes[i] = md->hash;
     }
 
-    if(DEBUG) printf("Loaded %d lcmtypes from %s\n", count, libname);
+    typecache_update(cache, job->libname, &job->st, count, names, hashes);
 
-    // cleanup
     free(names);
+    free(hashes);
+}
 
-    return 0;
+// add a library's types to the db. On conflicts, the library listed first
+// in the path wins, regardless of which thread finished first
+static void merge_types(lcmtype_db_t *this, lib_job_t *job)
+{
+    for(size_t i = 0; i < job->types->len; i++) {
+        lcmtype_metadata_t *md = g_ptr_array_index(job->types, i);
+
+        const lcmtype_metadata_t *prev = g_hash_table_lookup(this->hash_to_type, &md->hash);
+        if(prev != NULL) {
+            if(DEBUG) printf("WRN: ignoring %s (0x%"PRIx64") from '%s', already loaded as %s\n",
+                             md->typename, md->hash, job->libname, prev->typename);
+            lcmtype_metadata_destroy(md);
+            continue;
+        }
+
+        g_hash_table_insert(this->hash_to_type, &md->hash, md);
+        if(g_hash_table_lookup(this->name_to_hash, md->typename) == NULL) {
+            g_hash_table_insert(this->name_to_hash, md->typename, &md->hash);
+        } else {
+            if(DEBUG) printf("WRN: typename %s from '%s' has a different hash than an earlier one\n",
+                             md->typename, job->libname);
+        }
+    }
 }
 
 void destroy_types(GHashTable *types)
@@ -286,7 +435,7 @@ void destroy_types(GHashTable *types)
     g_hash_table_destroy(types);
 }
 
-lcmtype_db_t *lcmtype_db_create(const char *paths, int debug)
+lcmtype_db_t *lcmtype_db_create(const char *paths, const char *cache_filename, int debug)
 {
     /* TODO: put this in the lcmtype_db_t struct */
     DEBUG = debug;
@@ -301,25 +450,42 @@ lcmtype_db_t *lcmtype_db_create(const char *paths, int debug)
            g_str_hash, g_str_equal,
            NULL, NULL);
 
+    typecache_t *cache = (cache_filename != NULL) ? typecache_load(cache_filename) : NULL;
+
+    // the libraries are independent: scan and resolve each on its own thread
+    GArray *jobs = g_array_new(FALSE, TRUE, sizeof(lib_job_t));
     path_iter_t *pi = path_iter_create(paths);
 
     const char *libname;
     while((libname=path_iter_next(pi))) {
-        if(DEBUG) printf("Loading types from '%s'\n", libname);
-        void *lib = open_lib(libname);
-        if(lib == NULL) {
-            fprintf(stderr, "Err: failed to open '%s'\n", libname);
-            continue;
-        }
-        int ret = load_types(libname, lib,
-                             this->hash_to_type,
-                             this->name_to_hash);
-        if(ret != 0) {
-            fprintf(stderr, "Err: failed to load types from '%s'\n", libname);
-            continue;
-        }
+        lib_job_t job = { .libname = libname, .cache = cache, .types = g_ptr_array_new() };
+        g_array_append_val(jobs, job);
+    }
+
+    for(size_t i = 0; i < jobs->len; i++) {
+        lib_job_t *job = &g_array_index(jobs, lib_job_t, i);
+        job->has_thread = (pthread_create(&job->thread, NULL, lib_job_thread_func, job) == 0);
+        if(!job->has_thread)
+            lib_job_thread_func(job);
+    }
+
+    // merge in path order
+    for(size_t i = 0; i < jobs->len; i++) {
+        lib_job_t *job = &g_array_index(jobs, lib_job_t, i);
+        if(job->has_thread)
+            pthread_join(job->thread, NULL);
+        cache_types(cache, job);
+        merge_types(this, job);
+        g_ptr_array_free(job->types, TRUE);
+    }
+
+    if(cache != NULL) {
+        if(typecache_save(cache) != 0)
+            fprintf(stderr, "WRN: failed to write the type cache '%s'\n", cache_filename);
+        typecache_destroy(cache);
     }
 
+    g_array_free(jobs, TRUE);
     path_iter_destroy(pi);
     return this;
 }
@@ -346,3 +512,291 @@ const lcmtype_metadata_t *lcmtype_db_get_using_name(lcmtype_db_t *this, const ch
         return NULL;
     return g_hash_table_lookup(this->hash_to_type, hash);
 }
+
+static size_t primitive_size(lcm_field_type_t type)
+{
+    switch(type) {
+        case LCM_FIELD_INT8_T:   return sizeof(int8_t);
+        case LCM_FIELD_INT16_T:  return sizeof(int16_t);
+        case LCM_FIELD_INT32_T:  return sizeof(int32_t);
+        case LCM_FIELD_INT64_T:  return sizeof(int64_t);
+        case LCM_FIELD_BYTE:     return sizeof(int8_t);
+        case LCM_FIELD_FLOAT:    return sizeof(float);
+        case LCM_FIELD_DOUBLE:   return sizeof(double);
+        case LCM_FIELD_STRING:   return sizeof(const char *);
+        case LCM_FIELD_BOOLEAN:  return sizeof(int8_t);
+
+        case LCM_FIELD_USER_TYPE:
+        default:
+            return 0;
+    }
+}
+
+static inline int is_integer(const lcmtype_field_t *field)
+{
+    if(field->num_dim != 0)
+        return 0;
+
+    switch(field->type) {
+        case LCM_FIELD_INT8_T:
+        case LCM_FIELD_INT16_T:
+        case LCM_FIELD_INT32_T:
+        case LCM_FIELD_INT64_T:
+        case LCM_FIELD_BYTE:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static int64_t read_integer(const lcmtype_field_t *field, const void *msg)
+{
+    const void *p = (const uint8_t *) msg + field->offset;
+    switch(field->type) {
+        case LCM_FIELD_INT8_T:
+        case LCM_FIELD_BYTE:     return *(const int8_t *) p;
+        case LCM_FIELD_INT16_T:  return *(const int16_t *) p;
+        case LCM_FIELD_INT32_T:  return *(const int32_t *) p;
+        case LCM_FIELD_INT64_T:  return *(const int64_t *) p;
+        default:                 return 0;
+    }
+}
+
+static void write_integer(const lcmtype_field_t *field, void *msg, int64_t v)
+{
+    void *p = (uint8_t *) msg + field->offset;
+    switch(field->type) {
+        case LCM_FIELD_INT8_T:
+        case LCM_FIELD_BYTE:     *(int8_t *) p = v;  break;
+        case LCM_FIELD_INT16_T:  *(int16_t *) p = v; break;
+        case LCM_FIELD_INT32_T:  *(int32_t *) p = v; break;
+        case LCM_FIELD_INT64_T:  *(int64_t *) p = v; break;
+        default:                 break;
+    }
+}
+
+/* generated get_field() functions copy a variable dim out of its length
+   member, so give every integer member a distinct value in a scratch
+   message and see which one shows up in each variable dim */
+static void probe_dim_lengths(lcmtype_fields_t *this, void *scratch)
+{
+    int num_fields = this->num_fields;
+    for(int i = 0; i < num_fields; i++) {
+        lcmtype_field_t *field = &this->fields[i];
+        if(is_integer(field) && i+1 <= INT8_MAX)
+            write_integer(field, scratch, i+1);
+    }
+
+    for(int i = 0; i < num_fields; i++) {
+        lcmtype_field_t *field = &this->fields[i];
+        if(!field->has_variable_dim)
+            continue;
+
+        lcm_field_t f;
+        this->typeinfo->get_field(scratch, i, &f);
+        for(int d = 0; d < field->num_dim; d++) {
+            if(!field->dim_is_variable[d])
+                continue;
+            int32_t len_i = f.dim_size[d] - 1;
+            if(0 <= len_i && len_i < num_fields &&
+               is_integer(&this->fields[len_i]) &&
+               read_integer(&this->fields[len_i], scratch) == len_i+1)
+                field->dim_len_field[d] = len_i;
+        }
+    }
+}
+
+static lcmtype_fields_t *build_fields(lcmtype_db_t *db, const lcmtype_metadata_t *metadata)
+{
+    const lcm_type_info_t *typeinfo = metadata->typeinfo;
+    int num_fields = typeinfo->num_fields();
+    size_t struct_size = typeinfo->struct_size();
+
+    lcmtype_fields_t *this = calloc(1, sizeof(lcmtype_fields_t) + num_fields * sizeof(lcmtype_field_t));
+    this->typeinfo = typeinfo;
+    this->struct_size = struct_size;
+    this->num_fields = num_fields;
+    this->is_resolved = -1;
+
+    // the offsets are the same for any instance, a zeroed one will do
+    void *scratch = calloc(1, struct_size);
+
+    for(int i = 0; i < num_fields; i++) {
+        lcm_field_t f;
+        typeinfo->get_field(scratch, i, &f);
+
+        lcmtype_field_t *field = &this->fields[i];
+        field->index = i;
+        field->name = f.name;
+        field->typestr = f.typestr;
+        field->type = f.type;
+        field->offset = (uint8_t *) f.data - (uint8_t *) scratch;
+        field->num_dim = f.num_dim;
+        for(int d = 0; d < f.num_dim; d++) {
+            field->dim_is_variable[d] = f.dim_is_variable[d];
+            field->dim_size[d] = f.dim_is_variable[d] ? 0 : f.dim_size[d];
+            field->dim_len_field[d] = -1;
+            if(f.dim_is_variable[d])
+                field->has_variable_dim = 1; /* true */
+        }
+
+        if(f.type == LCM_FIELD_USER_TYPE) {
+            field->usertype = lcmtype_db_get_using_name(db, f.typestr);
+            if(field->usertype != NULL)
+                field->elt_size = field->usertype->typeinfo->struct_size();
+        } else {
+            field->elt_size = primitive_size(f.type);
+        }
+    }
+
+    probe_dim_lengths(this, scratch);
+    free(scratch);
+
+    if(DEBUG) printf("Built %d field descriptors for %s\n", num_fields, metadata->typename);
+    return this;
+}
+
+const lcmtype_fields_t *lcmtype_db_get_fields(lcmtype_db_t *this, const lcmtype_metadata_t *metadata)
+{
+    lcmtype_fields_t *fields = __atomic_load_n(&metadata->fields, __ATOMIC_ACQUIRE);
+    if(fields != NULL)
+        return fields;
+
+    // several threads may race to build the table: the first one wins
+    lcmtype_fields_t *built = build_fields(this, metadata);
+    lcmtype_metadata_t *md = (lcmtype_metadata_t *) metadata;
+    if(__atomic_compare_exchange_n(&md->fields, &fields, built, 0,
+                                   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        return built;
+
+    free(built);
+    return fields;
+}
+
+/* a depth-first walk of the nested types, each visited once: LCM allows
+   recursive types, so the walk must not follow the type graph blindly */
+static int walk_is_resolved(lcmtype_db_t *this, const lcmtype_metadata_t *metadata)
+{
+    GHashTable *visited = g_hash_table_new(g_direct_hash, g_direct_equal);
+    GPtrArray *stack = g_ptr_array_new();
+    int is_resolved = 1; /* true */
+
+    g_hash_table_insert(visited, (void *) metadata, (void *) metadata);
+    g_ptr_array_add(stack, (void *) metadata);
+    while(stack->len > 0 && is_resolved) {
+        const lcmtype_metadata_t *md = g_ptr_array_remove_index_fast(stack, stack->len - 1);
+        const lcmtype_fields_t *fields = lcmtype_db_get_fields(this, md);
+        for(int i = 0; i < fields->num_fields; i++) {
+            const lcmtype_field_t *field = &fields->fields[i];
+            if(field->type != LCM_FIELD_USER_TYPE)
+                continue;
+            if(field->usertype == NULL) {
+                is_resolved = 0; /* false */
+                break;
+            }
+            if(g_hash_table_lookup(visited, field->usertype) == NULL) {
+                g_hash_table_insert(visited, (void *) field->usertype, (void *) field->usertype);
+                g_ptr_array_add(stack, (void *) field->usertype);
+            }
+        }
+    }
+
+    g_ptr_array_free(stack, TRUE);
+    g_hash_table_destroy(visited);
+    return is_resolved;
+}
+
+int lcmtype_db_is_resolved(lcmtype_db_t *this, const lcmtype_metadata_t *metadata)
+{
+    lcmtype_fields_t *fields = (lcmtype_fields_t *) lcmtype_db_get_fields(this, metadata);
+    int is_resolved = __atomic_load_n(&fields->is_resolved, __ATOMIC_RELAXED);
+    if(is_resolved < 0) {
+        // racing threads compute the same value
+        is_resolved = walk_is_resolved(this, metadata);
+        __atomic_store_n(&fields->is_resolved, is_resolved, __ATOMIC_RELAXED);
+    }
+    return is_resolved;
+}
+
+/* nested types are encoded without their hash, and recursive types
+   always have a variable array somewhere, so the depth limit is a safety net */
+#define MAX_WIRE_DEPTH 16
+
+static int64_t struct_wire_size(lcmtype_db_t *this, const lcmtype_metadata_t *metadata, int depth);
+
+/* the encoded size of a field, -1 if it varies between messages */
+static int64_t field_wire_size(lcmtype_db_t *this, const lcmtype_field_t *field, int depth)
+{
+    if(field->has_variable_dim || field->type == LCM_FIELD_STRING)
+        return -1;
+
+    int64_t size;
+    if(field->type == LCM_FIELD_USER_TYPE) {
+        if(field->usertype == NULL || depth >= MAX_WIRE_DEPTH)
+            return -1;
+        size = struct_wire_size(this, field->usertype, depth + 1);
+        if(size < 0)
+            return -1;
+    } else {
+        // same as in memory, for the non-string primitives
+        size = field->elt_size;
+    }
+
+    for(int d = 0; d < field->num_dim; d++)
+        size *= field->dim_size[d];
+    return size;
+}
+
+static int64_t struct_wire_size(lcmtype_db_t *this, const lcmtype_metadata_t *metadata, int depth)
+{
+    const lcmtype_fields_t *fields = lcmtype_db_get_fields(this, metadata);
+    int64_t size = 0;
+    for(int i = 0; i < fields->num_fields; i++) {
+        int64_t fsize = field_wire_size(this, &fields->fields[i], depth);
+        if(fsize < 0)
+            return -1;
+        size += fsize;
+    }
+    return size;
+}
+
+int64_t lcmtype_db_wire_offset(lcmtype_db_t *this, const lcmtype_metadata_t *metadata,
+                               const lcmtype_field_t *field)
+{
+    const lcmtype_fields_t *fields = lcmtype_db_get_fields(this, metadata);
+    int64_t offset = sizeof(int64_t);
+    for(int i = 0; i < field->index && i < fields->num_fields; i++) {
+        int64_t fsize = field_wire_size(this, &fields->fields[i], 0);
+        if(fsize < 0)
+            return -1;
+        offset += fsize;
+    }
+    return offset;
+}
+
+int64_t lcmtype_db_wire_elt_size(lcmtype_db_t *this, const lcmtype_field_t *field)
+{
+    if(field->type == LCM_FIELD_STRING)
+        return -1;
+    if(field->type != LCM_FIELD_USER_TYPE)
+        return field->elt_size;
+    if(field->usertype == NULL)
+        return -1;
+    return struct_wire_size(this, field->usertype, 1);
+}
+
+int32_t lcmtype_fields_dim_size(const lcmtype_fields_t *this, const lcmtype_field_t *field,
+                                const void *msg, int dim)
+{
+    if(!field->dim_is_variable[dim])
+        return field->dim_size[dim];
+
+    int len_i = field->dim_len_field[dim];
+    if(len_i >= 0)
+        return read_integer(&this->fields[len_i], msg);
+
+    // unusual layout: ask the type itself
+    lcm_field_t f;
+    this->typeinfo->get_field(msg, field->index, &f);
+    return f.dim_size[dim];
+}
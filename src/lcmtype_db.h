@@ -8,23 +8,79 @@
 extern "C" {
 #endif
 
+typedef struct lcmtype_metadata lcmtype_metadata_t;
+typedef struct lcmtype_fields lcmtype_fields_t;
+
+/* describes one field of a type, independently of any message instance */
 typedef struct
+{
+    int index;
+    const char *name;
+    const char *typestr;
+    lcm_field_type_t type;
+    size_t offset;      /* of the field inside the message struct */
+
+    int num_dim;
+    int has_variable_dim;
+    int32_t dim_size[LCM_TYPE_FIELD_MAX_DIM];  /* only valid for fixed dims */
+    int8_t dim_is_variable[LCM_TYPE_FIELD_MAX_DIM];
+    int dim_len_field[LCM_TYPE_FIELD_MAX_DIM]; /* length member of a variable dim, or -1 */
+
+    size_t elt_size;    /* size of a single (non-array) value */
+    const lcmtype_metadata_t *usertype;  /* NULL unless LCM_FIELD_USER_TYPE */
+
+} lcmtype_field_t;
+
+struct lcmtype_fields
+{
+    const lcm_type_info_t *typeinfo;
+    size_t struct_size;
+    int num_fields;
+    int is_resolved;  /* -1 until known, see lcmtype_db_is_resolved() */
+    lcmtype_field_t fields[];
+};
+
+struct lcmtype_metadata
 {
     int64_t hash;
     char *typename;  /* owned by this struct */
     const lcm_type_info_t *typeinfo;
 
-} lcmtype_metadata_t;
+    /* built on first use, see lcmtype_db_get_fields() */
+    lcmtype_fields_t *fields;
+};
 
 typedef struct lcmtype_db lcmtype_db_t;
 
-lcmtype_db_t *lcmtype_db_create(const char *paths, int debug);
+// 'paths' is a colon separated list of lcmtype .so files
+// 'cache_filename' is the type catalog cache, or NULL to always scan the libraries
+lcmtype_db_t *lcmtype_db_create(const char *paths, const char *cache_filename, int debug);
 void lcmtype_db_destroy(lcmtype_db_t *this);
 
 // returns NULL when "not found"
 const lcmtype_metadata_t *lcmtype_db_get_using_hash(lcmtype_db_t *this, int64_t hash);
 const lcmtype_metadata_t *lcmtype_db_get_using_name(lcmtype_db_t *this, const char *name);
 
+// the field descriptors of a type, built once and then shared by all threads
+// a nested user-type that is not in the db has a NULL 'usertype'
+const lcmtype_fields_t *lcmtype_db_get_fields(lcmtype_db_t *this, const lcmtype_metadata_t *metadata);
+
+// non-zero if every nested user-type, at any depth, is in the db
+// computed once per type, recursive types included
+int lcmtype_db_is_resolved(lcmtype_db_t *this, const lcmtype_metadata_t *metadata);
+
+// the current length of a field's dimension, reading variable dims from 'msg'
+int32_t lcmtype_fields_dim_size(const lcmtype_fields_t *this, const lcmtype_field_t *field,
+                                const void *msg, int dim);
+
+// the offset of a field in the encoded message, counting the leading hash,
+// or -1 when a field before it has a variable encoded size (strings, variable arrays)
+int64_t lcmtype_db_wire_offset(lcmtype_db_t *this, const lcmtype_metadata_t *metadata,
+                               const lcmtype_field_t *field);
+
+// the encoded size of one element of a field (arrays excluded), -1 if it varies
+int64_t lcmtype_db_wire_elt_size(lcmtype_db_t *this, const lcmtype_field_t *field);
+
 #ifdef __cplusplus
 }
 #endif
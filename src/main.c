@@ -1,9 +1,24 @@
 #include "timeutil.h"
 #include "msg_display.h"
 #include "lcmtype_db.h"
+#include "msg_decode.h"
+#include "arena.h"
+#include "seqlock.h"
+#include "triple_buf.h"
+#include "rate_stats.h"
+#include "strbuf.h"
+#include "term_render.h"
+#include "stats_writer.h"
+#include "lcm_log_reader.h"
+#include "flight_rec.h"
+#include "work_pool.h"
+#include "histogram.h"
+#include "watch.h"
+#include "perf_counter.h"
 
 #include <glib.h>
 #include <inttypes.h>
+#include <math.h>
 #include <pthread.h>
 #include <signal.h>
 #include <stdio.h>
@@ -11,17 +26,36 @@
 #include <stdarg.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
 #include <termios.h>
+#include <time.h>
 #include <assert.h>
+#include <getopt.h>
 #include <lcm/lcm.h>
 #include <lcm/lcm_coretypes.h>
 
 #define SELECT_TIMEOUT 20000
+#define DEFAULT_RECORD_SIZE_MB 256
+#define MAX_WORKERS 256
+#define WORKER_QUEUE_SIZE (16*1024*1024)  /* bytes, per worker */
 #define ESCAPE_KEY 0x1B
 #define DEL_KEY 0x7f
 
+/* the keys sent as escape sequences, see read_key() */
+enum { KEY_UP = 0x100, KEY_DOWN, KEY_PAGE_UP, KEY_PAGE_DOWN, KEY_HOME, KEY_END };
+
+#define DEFAULT_SCREEN_ROWS 24  /* when the terminal size is unknown */
+
 /* this needs to be global unfortunately, so the sig_handler can set it to 1 */
 static volatile int64_t quit = 0;
+/* set by SIGUSR1 or the 'd' key, the dump thread then dumps the flight recorder */
+static volatile uint32_t dump_requested = 0;
+/* set by SIGWINCH, the keyboard thread then asks for a redraw */
+static volatile uint32_t resize_requested = 0;
+
+/* the type cache, in $XDG_CACHE_HOME or ~/.cache, see default_cache_filename() */
+#define CACHE_BASENAME "lcm-spy-lite-typecache"
 
 #define DEBUG_LEVEL 2  /* 0=nothing, higher values mean more verbosity */
 #define DEBUG_FILENAME "/tmp/spy-lite-debug.log"
@@ -45,20 +79,124 @@ static void DEBUG(int level, const char *fmt, ...)
 //////////////////////////////// Structs /////////////////////////////
 //////////////////////////////////////////////////////////////////////
 
+/* Threading model:
+     lcm threads:     one per url ('--url'), each the only writer of its
+                      provider's channel hashtable. They never wait on the
+                      other threads, except for the short 'channels_mutex'
+                      section when a new channel shows up, and the
+                      'recorder_mutex' when recording.
+     workers:         with '--workers', the lcm thread only copies each
+                      message into the queue of its channel's worker. The
+                      worker is then the only writer of that channel's
+                      statistics and raw message. Without workers, the lcm
+                      thread does this itself.
+     print thread:    reads statistics through a seqlock, the latest raw
+                      message through a triple buffer, and decodes it.
+     keyboard thread: owns the ui state, shared with the print thread
+                      under 'ui_mutex' (which is never held while printing).
+     dump thread:     with '--record', writes the flight recorder to a log
+                      on request. It reads the ring without 'recorder_mutex',
+                      so the lcm threads keep recording meanwhile.
+
+   Redraws are demand-driven: the lcm thread and the keyboard thread set
+   'is_dirty' when something visible changed, and only wake the print
+   thread when it is idle. That wakeup is signalled under 'ui_mutex', so
+   it cannot be lost. Without changes, the print thread backs off to one
+   frame every IDLE_PERIOD.
+*/
+
 typedef struct msg_info msg_info_t;
+typedef struct provider provider_t;
 
-enum display_mode { MODE_OVERVIEW, MODE_DECODE };
+enum display_mode { MODE_OVERVIEW, MODE_DECODE, MODE_DETAIL, MODE_WATCH };
 typedef struct spyinfo spyinfo_t;
+
+#define DEFAULT_TIME_FIELD "utime"
+#define MAX_TIME_FIELD_RULES 32
+
+typedef struct
+{
+    const char *typename;
+    const char *field;
+
+} time_field_rule_t;
+
+/* what lcm-spy-lite itself costs, see display_perf() */
+typedef struct
+{
+    perf_counter_t channels_waits;  /* contended lock acquisitions only */
+    perf_counter_t ui_waits;
+    perf_counter_t recorder_waits;
+    perf_counter_t frames;          /* building and rendering a frame */
+
+} spy_perf_t;
+
 struct spyinfo
 {
-    GArray *names_array;
-    GHashTable *minfo_hashtbl;
+    provider_t *providers;
+    int num_providers;
     lcmtype_db_t *type_db;
-    pthread_mutex_t mutex;
     float display_hz;
-
+    int use_arena;  /* decode into per-channel arenas */
+    int decode_all; /* decode every message, not only the displayed ones */
+
+
+    /* headless mode: the stats thread replaces the print and keyboard threads */
+    int is_headless;
+    double stats_interval;  /* seconds */
+    stats_writer_t *stats_writer;
+
+    /* flight recorder, shared by the lcm threads under 'recorder_mutex',
+       the dump thread reads it without the lock (see flight_rec_dump()).
+       Records carry no url: same-named channels of two urls are mixed */
+    pthread_mutex_t recorder_mutex;
+    flight_rec_t *recorder;     /* NULL when not recording */
+    const char *record_filename;
+    GRegex *record_regex;       /* NULL records every channel */
+    uint32_t num_dumps;         /* read atomically */
+
+    /* channel filters, see '--include', '--exclude' and '--stats-only' */
+    char *include_pattern;      /* the lcm subscription, NULL for all channels */
+    GRegex *include_regex;      /* the same, for log replays */
+    GRegex *exclude_regex;      /* NULL excludes nothing */
+    GRegex *stats_only_regex;   /* NULL decodes every channel */
+    int queue_capacity;         /* per subscription, 0 keeps lcm's default */
+
+    /* the watched fields, see '--watch' */
+    watch_t **watches;
+    int num_watches;
+
+    /* inter-arrival times above this are gaps, 0 for twice the channel's median */
+    uint64_t gap_threshold;     /* usec */
+
+    /* the timestamp fields latencies are measured from, see '--time-field' */
+    const char *time_field;     /* for the types without a rule */
+    time_field_rule_t time_field_rules[MAX_TIME_FIELD_RULES];
+    int num_time_field_rules;
+
+    /* all msg_info_t's sorted by channel name and provider, protected by channels_mutex */
+    pthread_mutex_t channels_mutex;
+    GPtrArray *channels;
+    uint32_t channels_gen;  /* bumped on every change, read atomically */
+
+    /* redraw scheduling, the flags are accessed atomically */
+    pthread_cond_t redraw_cond;  /* with ui_mutex */
+    uint32_t is_dirty;
+    uint32_t is_idle;
+    msg_info_t *visible_channel;  /* NULL when every channel is visible */
+
+    /* the decode screen's last layout, for scrolling: written by the print
+       thread, read by the keyboard thread, atomically */
+    size_t decode_num_lines;   /* of the whole message */
+    size_t decode_page_lines;  /* that fit on the screen */
+
+    spy_perf_t perf;
+
+    /* ui state, protected by ui_mutex */
+    pthread_mutex_t ui_mutex;
     enum display_mode mode;
     int is_selecting;
+    int show_perf;  /* the self-timing overlay */
 
     int decode_index;
     msg_info_t *decode_msg_info;
@@ -66,47 +204,216 @@ struct spyinfo
 };
 
 
-#define QUEUE_PERIOD (4*1000*1000)   /* queue up to 4 sec of utimes */
-#define QUEUE_SIZE   (400)           /* hold up to 400 utimes */
+#define MAX_URLS 16
 
-struct msg_info
+/* one lcm url, with its own lcm thread. Only that thread touches the
+   provider, so providers never contend with each other */
+struct provider
 {
-    const char *channel;
+    spyinfo_t *spy;
+    int index;
+    const char *url;  /* NULL for lcm's default */
+    pthread_t thread;
+
+    GHashTable *minfo_hashtbl;
+
+    /* the workers handling the messages, NULL when the lcm thread does it all
+       a channel always goes to the same worker, its 'shard' */
+    work_pool_t *pool;
+    unsigned num_shards_assigned;
+
+    perf_counter_t handler;  /* handler_all_lcm() */
+};
+
+/* only the waits are timed: an uncontended lock costs a trylock */
+static inline void timed_lock(pthread_mutex_t *mutex, perf_counter_t *waits)
+{
+    if(pthread_mutex_trylock(mutex) == 0)
+        return;
+
+    ss_timer_t timer;
+    tmr_tic(&timer);
+    pthread_mutex_lock(mutex);
+    perf_counter_add(waits, tmr_toc(&timer));
+}
+
+static inline const char *provider_name(const provider_t *this)
+{
+    return (this->url != NULL) ? this->url : "default";
+}
+
+/* message sizes are histogrammed by bit length: bucket i holds
+   sizes in [2^(i-1), 2^i), bucket 0 holds empty messages */
+#define SIZE_HIST_BUCKETS 33
 
-    uint64_t queue[QUEUE_SIZE];
-    int front;  // front: the next index to dequeue
-    int back;   // back-1: the last index enqueued
-    int is_full; // when front == back: the queue could be either full or empty (this disambiguates)
+/* the overview's latency column: the percentiles are refreshed from the
+   histogram at most every LATENCY_SUMMARY_PERIOD of message time */
+#define LATENCY_SUMMARY_PERIOD (100*1000)  /* usec */
+typedef struct
+{
+    uint64_t num_samples;
+    uint64_t p50;  /* usec */
+    uint64_t p99;
+    uint64_t max;
+    uint64_t num_negative;  /* clock skew: counted as 0 */
+
+} latency_summary_t;
+
+/* per-channel statistics: written by the lcm thread, copied out by
+   other threads with msg_info_get_stats(), every frame for every channel */
+typedef struct
+{
+    rate_stats_t rate;
+    uint64_t num_msgs;
+    uint64_t num_bytes;
+    uint64_t size_hist[SIZE_HIST_BUCKETS];
+
+    /* publish-to-receive latencies, from the type's timestamp field */
+    latency_summary_t latency;
+
+} msg_stats_t;
+
+/* the full timing histograms of a channel, kept apart from msg_stats_t
+   and copied out with msg_info_get_timing() by the timing details only */
+typedef struct
+{
+    histogram_t latency;  /* usec */
+    histogram_t period;   /* inter-arrival times (usec), since the first message */
+
+} msg_timing_t;
 
+struct msg_info
+{
+    const char *channel;
+    uint32_t channel_len;
+    provider_t *provider;
+    int is_recorded;  /* matches the flight recorder's channels */
+    int is_excluded;  /* filtered out: neither listed nor handled */
+    int is_stats_only; /* only counted: the type is never resolved */
+    unsigned shard;   /* selects the worker handling this channel */
     spyinfo_t *spy;
+
+    /* owned by the channel's worker ('hash' and 'metadata' are published atomically) */
     int64_t hash;
     const lcmtype_metadata_t *metadata;
-    msg_display_state_t disp_state;
+    int64_t time_offset;     /* of the timestamp in the encoded message, -1 if none */
+    const char *time_field;  /* its name, NULL if none */
+    watch_t **watches;       /* the watches bound to this channel */
+    int num_watches;
+
+    /* shared between the lcm thread (writer) and the print thread (reader) */
+    seqlock_t stats_lock;
+    msg_stats_t stats;
+    seqlock_t timing_lock;
+    msg_timing_t timing;
+    uint64_t latency_summary_utime;  /* of the last refresh, writer only */
+    triple_buf_t raw;  /* latest raw message, tagged with its metadata */
+
+    /* owned by the print thread: the lazily decoded message */
+    const lcmtype_metadata_t *decoded_metadata;
     void *last_msg;
-
-    uint64_t num_msgs;
+    int is_decoded;
+    int is_decode_failed; /* the latest message is invalid, it is not decoded again */
+    int is_arena_msg;     /* last_msg lives in 'arena', no decode_cleanup() */
+    arena_t arena;        /* reset for every decoded message */
+    void *msg_buf;        /* for the generated decoder */
+    size_t msg_buf_size;
+    uint64_t num_decodes;
+    uint64_t num_arena_decodes;
+    uint64_t allocs_avoided;
+    uint64_t num_decode_errors;
+    perf_counter_t decode_perf;
+
+    /* protected by spy->ui_mutex */
+    msg_display_state_t disp_state;
+    size_t disp_scroll;  /* the first line of the message on screen */
 };
 
-static msg_info_t *msg_info_create(spyinfo_t *spy, const char *channel)
+static msg_info_t *msg_info_create(provider_t *provider, const char *channel)
 {
+    spyinfo_t *spy = provider->spy;
     msg_info_t *this = calloc(1, sizeof(msg_info_t));
+    this->provider = provider;
     this->channel = channel;
-
-    this->front = 0;
-    this->back = 0;
-    this->is_full = 0; /* false */
-
+    this->channel_len = strlen(channel);
+    this->is_recorded = 0; /* false */
+    this->is_excluded = 0; /* false */
+    this->is_stats_only = 0; /* false */
     this->spy = spy;
+
     this->hash = 0;
     this->metadata = NULL;
-    this->disp_state.cur_depth = 0;
+    this->time_offset = -1;
+    this->time_field = NULL;
+    this->watches = NULL;
+    this->num_watches = 0;
+
+    seqlock_init(&this->stats_lock);
+    rate_stats_init(&this->stats.rate);
+    this->stats.num_msgs = 0;
+    this->stats.num_bytes = 0;
+    memset(this->stats.size_hist, 0, sizeof(this->stats.size_hist));
+    memset(&this->stats.latency, 0, sizeof(this->stats.latency));
+    seqlock_init(&this->timing_lock);
+    histogram_init(&this->timing.latency);
+    histogram_init(&this->timing.period);
+    this->latency_summary_utime = 0;
+    triple_buf_init(&this->raw);
+
+    this->decoded_metadata = NULL;
     this->last_msg = NULL;
+    this->is_decoded = 0; /* false */
+    this->is_decode_failed = 0; /* false */
+    this->is_arena_msg = 0; /* false */
+    arena_init(&this->arena);
+    this->msg_buf = NULL;
+    this->msg_buf_size = 0;
+    this->num_decodes = 0;
+    this->num_arena_decodes = 0;
+    this->allocs_avoided = 0;
+    this->num_decode_errors = 0;
 
-    this->num_msgs = 0;
+    this->disp_state.cur_depth = 0;
+    this->disp_scroll = 0;
 
     return this;
 }
 
+/* the timestamp field of a type is the one of its '--time-field TYPE=FIELD'
+   rule, or the default one. It must be a top-level int64 at a fixed offset
+   in the encoded message, so it can be read without decoding.
+   Returns that offset, or -1 */
+static int64_t find_time_field(spyinfo_t *spy, const lcmtype_metadata_t *metadata, const char **name)
+{
+    const char *field_name = spy->time_field;
+    for(int i = 0; i < spy->num_time_field_rules; i++) {
+        if(strcmp(spy->time_field_rules[i].typename, metadata->typename) == 0) {
+            field_name = spy->time_field_rules[i].field;
+            break;
+        }
+    }
+
+    const lcmtype_fields_t *fields = lcmtype_db_get_fields(spy->type_db, metadata);
+    for(int i = 0; i < fields->num_fields; i++) {
+        const lcmtype_field_t *field = &fields->fields[i];
+        if(strcmp(field->name, field_name) != 0)
+            continue;
+
+        if(field->type != LCM_FIELD_INT64_T || field->num_dim != 0) {
+            DEBUG(1, "WRN: %s.%s is not an int64_t, no latencies\n", metadata->typename, field_name);
+            return -1;
+        }
+        int64_t offset = lcmtype_db_wire_offset(spy->type_db, metadata, field);
+        if(offset < 0) {
+            DEBUG(1, "WRN: %s.%s has no fixed offset, no latencies\n", metadata->typename, field_name);
+            return -1;
+        }
+        *name = field->name;
+        return offset;
+    }
+    return -1;
+}
+
 static void _msg_info_ensure_hash(msg_info_t *this, int64_t hash)
 {
     if(this->hash == hash)
@@ -117,155 +424,267 @@ static void _msg_info_ensure_hash(msg_info_t *this, int64_t hash)
         DEBUG(1, "WRN: hash changed, searching for new lcmtype on channel %s\n", this->channel);
     }
 
-    // cleanup old memory if needed
-    if(this->metadata != NULL && this->last_msg != NULL) {
-        this->metadata->typeinfo->decode_cleanup(this->last_msg);
-        free(this->last_msg);
-        this->last_msg = NULL;
-    }
+    __atomic_store_n(&this->hash, hash, __ATOMIC_RELAXED);
+    const lcmtype_metadata_t *metadata = lcmtype_db_get_using_hash(this->spy->type_db, hash);
+    __atomic_store_n(&this->metadata, metadata, __ATOMIC_RELEASE);
 
-    this->hash = hash;
-    this->metadata = lcmtype_db_get_using_hash(this->spy->type_db, hash);
-    if(this->metadata == NULL) {
+    const char *time_field = NULL;
+    this->time_offset = -1;
+    if(metadata != NULL)
+        this->time_offset = find_time_field(this->spy, metadata, &time_field);
+    __atomic_store_n(&this->time_field, time_field, __ATOMIC_RELEASE);
+
+    for(int i = 0; i < this->num_watches; i++)
+        if(watch_compile(this->watches[i], this->channel, this->spy->type_db, metadata) != 0)
+            DEBUG(1, "WRN: cannot watch '%s': %s\n", watch_path(this->watches[i]),
+                  watch_error(this->watches[i]));
+
+    if(metadata == NULL) {
         DEBUG(1, "WRN: failed to find lcmtype for hash: 0x%"PRIx64"\n", hash);
         return;
     }
 }
 
-static inline int _msg_info_is_empty(msg_info_t *this)
+static inline int size_hist_bucket(uint32_t size)
 {
-    return !this->is_full && (this->front == this->back);
+    return (size == 0) ? 0 : 32 - __builtin_clz(size);
 }
 
-static inline int _msg_info_get_size(msg_info_t *this)
+static void msg_info_add_msg(msg_info_t *this, uint64_t utime, const void *data, uint32_t size)
 {
-    if(this->is_full)
-        return QUEUE_SIZE;
-    if(this->front <= this->back)
-        return this->back - this->front;
-    else /* this->front > this->back */
-        return QUEUE_SIZE - (this->front - this->back);
+    /* resolve the type, all lcm messages start with their 64-bit hash */
+    if(!this->is_stats_only && size >= sizeof(int64_t)) {
+        int64_t hash;
+        __int64_t_decode_array(data, 0, size, &hash, 1);
+        _msg_info_ensure_hash(this, hash);
+    }
+
+    /* the timestamp is read straight from the encoded message, unset (0) ones are ignored */
+    int64_t sent = 0;
+    if(this->time_offset >= 0 && this->time_offset + sizeof(int64_t) <= size)
+        __int64_t_decode_array(data, this->time_offset, size - this->time_offset, &sent, 1);
+
+    int64_t latency = 0;
+    int is_negative = 0; /* false */
+    if(sent > 0) {
+        latency = (int64_t) utime - sent;
+        if(latency < 0) {
+            is_negative = 1; /* true */
+            latency = 0;
+        }
+    }
+
+    seqlock_write_begin(&this->timing_lock);
+    {
+        if(this->stats.num_msgs > 0 && utime >= this->stats.rate.last_utime)
+            histogram_add(&this->timing.period, utime - this->stats.rate.last_utime);
+        if(sent > 0)
+            histogram_add(&this->timing.latency, latency);
+    }
+    seqlock_write_end(&this->timing_lock);
+
+    // the percentiles scan the histogram, outside of the readers' way
+    latency_summary_t summary = this->stats.latency;
+    if(sent > 0) {
+        summary.num_samples++;
+        summary.num_negative += is_negative;
+        summary.max = this->timing.latency.max;
+        if(summary.num_samples == 1 || utime < this->latency_summary_utime ||
+           utime - this->latency_summary_utime >= LATENCY_SUMMARY_PERIOD) {
+            summary.p50 = histogram_percentile(&this->timing.latency, 50.0);
+            summary.p99 = histogram_percentile(&this->timing.latency, 99.0);
+            this->latency_summary_utime = utime;
+        }
+    }
+
+    seqlock_write_begin(&this->stats_lock);
+    {
+        rate_stats_add(&this->stats.rate, utime, size);
+        this->stats.num_msgs++;
+        this->stats.num_bytes += size;
+        this->stats.size_hist[size_hist_bucket(size)]++;
+        this->stats.latency = summary;
+    }
+    seqlock_write_end(&this->stats_lock);
+
+    if(this->is_stats_only)
+        return;
+
+    for(int i = 0; i < this->num_watches; i++)
+        watch_add_msg(this->watches[i], this->channel, utime, data, size);
+
+    // nothing decodes messages in headless mode
+    if(this->metadata == NULL || this->spy->is_headless)
+        return;
+
+    /* publish a copy of the raw data, decoding is deferred to msg_info_get_msg() */
+    triple_buf_slot_t *slot = triple_buf_write_slot(&this->raw, size);
+    memcpy(slot->data, data, size);
+    slot->tag = this->metadata;
+    triple_buf_publish(&this->raw);
 }
 
-static inline void _msg_info_dequeue(msg_info_t *this)
+/* copy out a consistent snapshot of the statistics, never blocks the writer */
+static void msg_info_get_stats(const msg_info_t *this, msg_stats_t *stats)
 {
-    /* assert not empty */
-    assert(!_msg_info_is_empty(this));
-    ++this->front;
-    this->front %= QUEUE_SIZE;
-    this->is_full = 0; /* false */
+    uint32_t s;
+    do {
+        s = seqlock_read_begin(&this->stats_lock);
+        memcpy(stats, &this->stats, sizeof(msg_stats_t));
+    } while(seqlock_read_retry(&this->stats_lock, s));
 }
 
-static inline void _msg_info_enqueue(msg_info_t *this, uint64_t utime)
+/* the same for the timing histograms, a few KB: only for one channel at a time */
+static void msg_info_get_timing(const msg_info_t *this, msg_timing_t *timing)
 {
-    assert(!this->is_full);
-    this->queue[this->back++] = utime;
-    this->back %= QUEUE_SIZE;
-    if(this->front == this->back)
-        this->is_full = 1; /* true */
+    uint32_t s;
+    do {
+        s = seqlock_read_begin(&this->timing_lock);
+        memcpy(timing, &this->timing, sizeof(msg_timing_t));
+    } while(seqlock_read_retry(&this->timing_lock, s));
 }
 
-static uint64_t _msg_info_latest_utime(msg_info_t *this)
+static const lcmtype_metadata_t *msg_info_get_metadata(const msg_info_t *this)
 {
-    assert(!_msg_info_is_empty(this));
-
-    int i = this->back - 1;
-    if(i < 0)
-        i = QUEUE_SIZE - 1;
-
-    return this->queue[i];
+    return __atomic_load_n(&this->metadata, __ATOMIC_ACQUIRE);
 }
 
-static uint64_t _msg_info_oldest_utime(msg_info_t *this)
+/* frees whatever the previous decode allocated */
+static void msg_info_release_msg(msg_info_t *this)
 {
-    assert(!_msg_info_is_empty(this));
-    return this->queue[this->front];
+    if(this->is_decoded && !this->is_arena_msg)
+        this->decoded_metadata->typeinfo->decode_cleanup(this->last_msg);
+    this->last_msg = NULL;
+    this->is_decoded = 0; /* false */
+    this->is_decode_failed = 0; /* false */
+    this->is_arena_msg = 0; /* false */
 }
 
-static void _msg_info_remove_old(msg_info_t *this)
-{
-    uint64_t oldest_allowed = timestamp_now() - QUEUE_PERIOD;
+static void *msg_info_decode(msg_info_t *this, const lcmtype_metadata_t *md, const void *data, size_t size);
 
-    // discard old messages
-    while(!_msg_info_is_empty(this)) {
-        uint64_t last = this->queue[this->front];
-        if(last < oldest_allowed)
-            _msg_info_dequeue(this);
-        else
-            break;
+/* returns the latest decoded message (and its type), or NULL if none are
+   available. Every message is decoded at most once: a message that failed
+   to decode stays failed (see 'is_decode_failed') until the next one.
+   Must only be called from the print thread */
+static void *msg_info_get_msg(msg_info_t *this, const lcmtype_metadata_t **metadata)
+{
+    int is_new;
+    triple_buf_slot_t *slot = triple_buf_read(&this->raw, &is_new);
+    if(slot == NULL)
+        return NULL;
+
+    if(!is_new) {
+        *metadata = this->decoded_metadata;
+        return this->is_decoded ? this->last_msg : NULL;
     }
 
+    const lcmtype_metadata_t *md = slot->tag;
+    void *msg = msg_info_decode(this, md, slot->data, slot->size);
+    if(msg != NULL)
+        *metadata = md;
+    return msg;
 }
 
-static void msg_info_add_msg(msg_info_t *this, uint64_t utime, const lcm_recv_buf_t *rbuf)
-{
-    if(this->is_full)
-        _msg_info_dequeue(this);
-
-    _msg_info_enqueue(this, utime);
-
-    this->num_msgs++;
-
-    /* decode the data */
-    int64_t hash;
-    __int64_t_decode_array(rbuf->data, 0, rbuf->data_size, &hash, 1);
-    _msg_info_ensure_hash(this, hash);
+/* decodes 'data' into 'last_msg', replacing the previous message
+   returns NULL on failure */
+static void *_msg_info_decode(msg_info_t *this, const lcmtype_metadata_t *md, const void *data, size_t size);
 
-    if(this->metadata != NULL) {
+static void *msg_info_decode(msg_info_t *this, const lcmtype_metadata_t *md, const void *data, size_t size)
+{
+    ss_timer_t timer;
+    tmr_tic(&timer);
+    void *msg = _msg_info_decode(this, md, data, size);
+    perf_counter_add(&this->decode_perf, tmr_toc(&timer));
+    return msg;
+}
 
-        // do we need to allocate memory for 'last_msg' ?
-        if(this->last_msg == NULL) {
-            size_t sz = this->metadata->typeinfo->struct_size();
-            this->last_msg = malloc(sz);
-        } else {
-            this->metadata->typeinfo->decode_cleanup(this->last_msg);
+static void *_msg_info_decode(msg_info_t *this, const lcmtype_metadata_t *md, const void *data, size_t size)
+{
+    msg_info_release_msg(this);
+    this->decoded_metadata = md;
+    this->num_decodes++;
+
+    // decode into the arena, nothing has to be freed for the next message
+    if(this->spy->use_arena) {
+        uint64_t num_allocs;
+        arena_reset(&this->arena);
+        void *msg = msg_decode(this->spy->type_db, md, data, size,
+                               &this->arena, &num_allocs);
+        if(msg != NULL) {
+            this->last_msg = msg;
+            this->is_arena_msg = 1; /* true */
+            this->is_decoded = 1; /* true */
+            this->num_arena_decodes++;
+            this->allocs_avoided += num_allocs;
+            return msg;
         }
 
-        // actually decode it
-        this->metadata->typeinfo->decode(rbuf->data, 0, rbuf->data_size, this->last_msg);
-
-        DEBUG(1, "INFO: successful decode on %s\n", this->channel);
+        // the generated decoder would reject the data too, and leak what it
+        // allocated before noticing
+        if(msg_decode_is_supported(this->spy->type_db, md)) {
+            DEBUG(1, "WRN: failed to decode message on %s\n", this->channel);
+            this->num_decode_errors++;
+            this->is_decode_failed = 1; /* true */
+            return NULL;
+        }
+        DEBUG(1, "INFO: arena decode failed on %s, using the generated decoder\n", this->channel);
     }
 
-}
-
-static float msg_info_get_hz(msg_info_t *this)
-{
-    _msg_info_remove_old(this);
-    if(_msg_info_is_empty(this))
-        return 0.0;
-
-    int sz = _msg_info_get_size(this);
-    uint64_t old = _msg_info_oldest_utime(this);
-    uint64_t new = _msg_info_latest_utime(this);
-    uint64_t dt = new - old;
-    if(dt == 0.0)
-        return 0.0;
+    // do we need to allocate memory for the message struct ?
+    size_t sz = md->typeinfo->struct_size();
+    if(this->msg_buf_size < sz) {
+        free(this->msg_buf);
+        this->msg_buf = malloc(sz);
+        this->msg_buf_size = sz;
+    }
+    this->last_msg = this->msg_buf;
+
+    // actually decode it
+    // on failure, the generated decoder leaks what it allocated so far
+    int ret = md->typeinfo->decode(data, 0, size, this->last_msg);
+    if(ret < 0) {
+        DEBUG(1, "WRN: failed to decode message on %s\n", this->channel);
+        this->num_decode_errors++;
+        this->is_decode_failed = 1; /* true */
+        return NULL;
+    }
 
-    return (float) sz / ((float) dt / 1000000.0);
+    DEBUG(1, "INFO: successful decode on %s\n", this->channel);
+    this->is_decoded = 1; /* true */
+    return this->last_msg;
 }
 
+/* requires spy->ui_mutex */
 static msg_info_t *get_current_msg_info(spyinfo_t *spy, const char **channel)
 {
-    const char *ch = g_array_index(spy->names_array, const char *, spy->decode_index);
-    assert(ch != NULL);
-    msg_info_t *minfo = (msg_info_t *) g_hash_table_lookup(spy->minfo_hashtbl, ch);
+    msg_info_t *minfo;
+    timed_lock(&spy->channels_mutex, &spy->perf.channels_waits);
+    {
+        minfo = g_ptr_array_index(spy->channels, spy->decode_index);
+    }
+    pthread_mutex_unlock(&spy->channels_mutex);
+
     assert(minfo != NULL);
-    if(channel != NULL) *channel = ch;
+    if(channel != NULL) *channel = minfo->channel;
     return minfo;
 }
 
 static void msg_info_destroy(msg_info_t *this)
 {
+    msg_info_release_msg(this);
+    arena_cleanup(&this->arena);
+    free(this->msg_buf);
+    triple_buf_cleanup(&this->raw);
+    free(this->watches);
     free(this);
 }
 
 static int is_valid_channel_num(spyinfo_t *spy, int index)
 {
-    return (0 <= index && index < spy->names_array->len);
+    return (0 <= index && index < __atomic_load_n(&spy->channels->len, __ATOMIC_ACQUIRE));
 }
 
-static void keyboard_handle_overview(spyinfo_t *spy, char ch)
+static void keyboard_handle_overview(spyinfo_t *spy, int ch)
 {
     if(ch == '-') {
         spy->is_selecting = 1; /* true */
@@ -294,6 +713,8 @@ static void keyboard_handle_overview(spyinfo_t *spy, char ch)
             }
             spy->is_selecting = 0; /* false */
         }
+    } else if(ch == 'w' && !spy->is_selecting) {
+        spy->mode = MODE_WATCH;
     } else if(ch == '\b' || ch == DEL_KEY) {
         if(spy->is_selecting) {
             if(spy->decode_index < 10)
@@ -306,20 +727,54 @@ static void keyboard_handle_overview(spyinfo_t *spy, char ch)
     }
 }
 
-static void keyboard_handle_decode(spyinfo_t *spy, char ch)
+/* moves the decode screen by 'delta' lines, without leaving the message */
+static void scroll_decode(msg_info_t *minfo, int64_t delta, size_t max_scroll)
+{
+    int64_t scroll = (int64_t) minfo->disp_scroll + delta;
+    if(scroll > (int64_t) max_scroll)
+        scroll = max_scroll;
+    if(scroll < 0)
+        scroll = 0;
+    minfo->disp_scroll = scroll;
+}
+
+static void keyboard_handle_decode(spyinfo_t *spy, int ch)
 {
     msg_info_t *minfo = spy->decode_msg_info;
     msg_display_state_t *ds = &minfo->disp_state;
 
+    // scrolling is bounded by the layout of the last frame
+    size_t num_lines = __atomic_load_n(&spy->decode_num_lines, __ATOMIC_RELAXED);
+    size_t page = __atomic_load_n(&spy->decode_page_lines, __ATOMIC_RELAXED);
+    size_t max_scroll = (num_lines > page) ? num_lines - page : 0;
+    if(page == 0)
+        page = 1;
+
     if(ch == ESCAPE_KEY) {
+        minfo->disp_scroll = 0;
         if(ds->cur_depth > 0)
             ds->cur_depth--;
         else
             spy->mode = MODE_OVERVIEW;
+    } else if(ch == 'p') {
+        spy->mode = MODE_DETAIL;
+    } else if(ch == KEY_DOWN || ch == 'j') {
+        scroll_decode(minfo, 1, max_scroll);
+    } else if(ch == KEY_UP || ch == 'k') {
+        scroll_decode(minfo, -1, max_scroll);
+    } else if(ch == KEY_PAGE_DOWN || ch == ' ') {
+        scroll_decode(minfo, page, max_scroll);
+    } else if(ch == KEY_PAGE_UP || ch == 'b') {
+        scroll_decode(minfo, -(int64_t) page, max_scroll);
+    } else if(ch == KEY_HOME || ch == 'g') {
+        minfo->disp_scroll = 0;
+    } else if(ch == KEY_END || ch == 'G') {
+        minfo->disp_scroll = max_scroll;
     } else if('0' <= ch && ch <= '9') {
         // if number is pressed, set and increase sub-msg decoding depth
         if(ds->cur_depth < MSG_DISPLAY_RECUR_MAX) {
             ds->recur_table[ds->cur_depth++] = (ch - '0');
+            minfo->disp_scroll = 0;
         } else {
             DEBUG(1, "INFO: cannot recurse further: reached maximum depth of %d\n",
                   MSG_DISPLAY_RECUR_MAX);
@@ -329,6 +784,93 @@ static void keyboard_handle_decode(spyinfo_t *spy, char ch)
     }
 }
 
+static void keyboard_handle_watch(spyinfo_t *spy, int ch)
+{
+    if(ch == ESCAPE_KEY || ch == 'w') {
+        spy->mode = MODE_OVERVIEW;
+    } else {
+        DEBUG(1, "INFO: unrecognized input: '%c' (0x%2x)\n", ch, ch);
+    }
+}
+
+static void keyboard_handle_detail(spyinfo_t *spy, int ch)
+{
+    if(ch == ESCAPE_KEY || ch == 'p') {
+        spy->mode = MODE_DECODE;
+    } else {
+        DEBUG(1, "INFO: unrecognized input: '%c' (0x%2x)\n", ch, ch);
+    }
+}
+
+/* the next key in 'buf': a character, or one of the KEY_* sent as escape
+   sequences. An unknown sequence is 0, an ESC on its own is ESCAPE_KEY.
+   Returns the number of chars used */
+static int read_key(const char *buf, int len, int *key)
+{
+    *key = (uint8_t) buf[0];
+    if(buf[0] != ESCAPE_KEY || len < 3 || (buf[1] != '[' && buf[1] != 'O'))
+        return 1;
+
+    // "ESC [ A" and "ESC O A" for the arrows, "ESC [ 5 ~" for the others
+    int n = 2;
+    int num = 0;
+    while(n < len && '0' <= buf[n] && buf[n] <= '9')
+        num = num * 10 + (buf[n++] - '0');
+    if(n == len)
+        return 1;
+
+    switch(buf[n++]) {
+        case 'A': *key = KEY_UP;   break;
+        case 'B': *key = KEY_DOWN; break;
+        case 'H': *key = KEY_HOME; break;
+        case 'F': *key = KEY_END;  break;
+        case '~':
+            switch(num) {
+                case 1: case 7: *key = KEY_HOME;      break;
+                case 4: case 8: *key = KEY_END;       break;
+                case 5:         *key = KEY_PAGE_UP;   break;
+                case 6:         *key = KEY_PAGE_DOWN; break;
+                default:        *key = 0;
+            }
+            break;
+        default:
+            *key = 0;
+    }
+    return n;
+}
+
+static void keyboard_handle_key(spyinfo_t *spy, int ch)
+{
+    if(ch == 'd' && spy->recorder != NULL) {
+        __atomic_store_n(&dump_requested, 1, __ATOMIC_RELEASE);
+        return;
+    }
+
+    timed_lock(&spy->ui_mutex, &spy->perf.ui_waits);
+    {
+        // the self-timing overlay works on every screen
+        if(ch == 'o') {
+            spy->show_perf = !spy->show_perf;
+        } else {
+            switch(spy->mode) {
+                case MODE_OVERVIEW: keyboard_handle_overview(spy, ch); break;
+                case MODE_DECODE:   keyboard_handle_decode(spy, ch);  break;
+                case MODE_DETAIL:   keyboard_handle_detail(spy, ch);  break;
+                case MODE_WATCH:    keyboard_handle_watch(spy, ch);   break;
+                default:
+                    DEBUG(1, "INFO: unrecognized keyboard mode: %d\n", spy->mode);
+            }
+        }
+
+        int is_one_channel = (spy->mode == MODE_DECODE || spy->mode == MODE_DETAIL);
+        msg_info_t *visible = is_one_channel ? spy->decode_msg_info : NULL;
+        __atomic_store_n(&spy->visible_channel, visible, __ATOMIC_RELEASE);
+        __atomic_store_n(&spy->is_dirty, 1, __ATOMIC_SEQ_CST);
+        pthread_cond_signal(&spy->redraw_cond);
+    }
+    pthread_mutex_unlock(&spy->ui_mutex);
+}
+
 void *keyboard_thread_func(void *arg)
 {
     spyinfo_t *spy = (spyinfo_t *)arg;
@@ -345,7 +887,8 @@ void *keyboard_thread_func(void *arg)
     if (tcsetattr(0, TCSANOW, &new) < 0)
         perror("tcsetattr ICANON");
 
-    char ch;
+    // escape sequences arrive in a single read
+    char buf[64];
     while(!quit) {
         fd_set fds;
         FD_ZERO(&fds);
@@ -357,21 +900,32 @@ void *keyboard_thread_func(void *arg)
         if(quit)
             break;
 
-        if(status != 0 && FD_ISSET(0, &fds)) {
+        // redraw at the new terminal size right away
+        if(__atomic_exchange_n(&resize_requested, 0, __ATOMIC_ACQ_REL)) {
+            timed_lock(&spy->ui_mutex, &spy->perf.ui_waits);
+            __atomic_store_n(&spy->is_dirty, 1, __ATOMIC_SEQ_CST);
+            pthread_cond_signal(&spy->redraw_cond);
+            pthread_mutex_unlock(&spy->ui_mutex);
+        }
 
-            if(read(0, &ch, 1) < 0)
-                perror ("read()");
+        // 'status' is -1 when a signal interrupted select()
+        if(status > 0 && FD_ISSET(0, &fds)) {
 
-            pthread_mutex_lock(&spy->mutex);
-            {
-                switch(spy->mode) {
-                    case MODE_OVERVIEW: keyboard_handle_overview(spy, ch); break;
-                    case MODE_DECODE:   keyboard_handle_decode(spy, ch);  break;
-                    default:
-                        DEBUG(1, "INFO: unrecognized keyboard mode: %d\n", spy->mode);
-                }
+            int len = read(0, buf, sizeof(buf));
+            if(len <= 0) {
+                if(len < 0)
+                    perror ("read()");
+                continue;
+            }
+
+            for(int i = 0; i < len; ) {
+                int ch;
+                i += read_key(buf + i, len - i, &ch);
+                if(ch != 0)
+                    keyboard_handle_key(spy, ch);
+                else
+                    DEBUG(1, "INFO: unrecognized escape sequence\n");
             }
-            pthread_mutex_unlock(&spy->mutex);
 
         } else {
             DEBUG(4, "INFO: keyboard_thread_func select() timeout\n");
@@ -387,58 +941,589 @@ void *keyboard_thread_func(void *arg)
 ////////////////////////// Helper Functions //////////////////////////
 //////////////////////////////////////////////////////////////////////
 
-void clearscreen()
+static size_t count_lines(const strbuf_t *s)
+{
+    size_t n = 0;
+    for(size_t i = 0; i < s->len; i++)
+        n += (s->data[i] == '\n');
+    return n;
+}
+
+/* human readable byte count, e.g. "12.3 KB" */
+static void append_bytes(strbuf_t *out, double bytes)
+{
+    static const char *units[] = { " B", " KB", " MB", " GB", " TB" };
+    int u = 0;
+    while(bytes >= 1024.0 && u < 4) {
+        bytes /= 1024.0;
+        u++;
+    }
+    strbuf_append_double(out, bytes, (u == 0) ? 0 : 1);
+    strbuf_append_str(out, units[u]);
+}
+
+/* the overview's numeric columns: '\t' then right-justified */
+static inline void append_u64_col(strbuf_t *out, uint64_t v, int width)
+{
+    strbuf_append_char(out, '\t');
+    size_t start = out->len;
+    strbuf_append_u64(out, v);
+    strbuf_rjust(out, start, width);
+}
+
+static inline void append_bytes_col(strbuf_t *out, double bytes, const char *suffix, int width)
 {
-    // clear
-    printf("\033[2J");
+    strbuf_append_char(out, '\t');
+    size_t start = out->len;
+    append_bytes(out, bytes);
+    strbuf_append_str(out, suffix);
+    strbuf_rjust(out, start, width);
+}
 
-    // move cursor to (0, 0)
-    printf("\033[0;0H");
+/* usec as msec, with a precision that fits the value */
+static void append_msec(strbuf_t *out, uint64_t usec)
+{
+    double ms = usec / 1000.0;
+    strbuf_append_double(out, ms, (ms < 10.0) ? 2 : (ms < 100.0) ? 1 : 0);
+}
+
+/* "p50/p99/max" in msec, "-" without latencies */
+static void append_latency_col(strbuf_t *out, const latency_summary_t *latency, int width)
+{
+    strbuf_append_char(out, '\t');
+    size_t start = out->len;
+    if(latency->num_samples == 0) {
+        strbuf_append_char(out, '-');
+    } else {
+        append_msec(out, latency->p50);
+        strbuf_append_char(out, '/');
+        append_msec(out, latency->p99);
+        strbuf_append_char(out, '/');
+        append_msec(out, latency->max);
+    }
+    strbuf_rjust(out, start, width);
 }
 
 //////////////////////////////////////////////////////////////////////
 //////////////////////////// Print Thread ////////////////////////////
 //////////////////////////////////////////////////////////////////////
 
-static void display_overview(spyinfo_t *spy)
+/* everything the print thread needs for one frame, copied out of the
+   shared state so that no lock is held while printing */
+typedef struct
 {
-    printf("         %-28s\t%12s\t%8s\n", "Channel", "Num Messages", "Hz (ave)");
-    printf("   ----------------------------------------------------------------\n");
+    enum display_mode mode;
+    int is_selecting;
+    int decode_index;
+    msg_info_t *decode_msg_info;
+    const char *decode_msg_channel;
+    msg_display_state_t disp_state;
+    msg_display_cache_t disp_cache;
+    size_t disp_scroll;
+    int screen_rows;  /* left for the screen, below the self-timing overlay */
+
+    /* the self-timing overlay, with its rates updated every second */
+    int show_perf;
+    uint64_t perf_utime;
+    uint64_t perf_prev_handled[MAX_URLS];
+    uint64_t perf_prev_frames;
+    double handled_hz[MAX_URLS];
+    double frames_hz;
+
+    /* the print thread's copy of spy->channels */
+    msg_info_t **channels;
+    size_t num_channels;
+    size_t channels_alloc;
+    uint32_t channels_gen;
+
+} view_t;
+
+static void view_update_channels(view_t *view, spyinfo_t *spy);
+
+static void view_update(view_t *view, spyinfo_t *spy)
+{
+    timed_lock(&spy->ui_mutex, &spy->perf.ui_waits);
+    {
+        view->mode = spy->mode;
+        view->is_selecting = spy->is_selecting;
+        view->decode_index = spy->decode_index;
+        view->decode_msg_info = spy->decode_msg_info;
+        view->decode_msg_channel = spy->decode_msg_channel;
+        view->show_perf = spy->show_perf;
+        if(view->mode == MODE_DECODE) {
+            view->disp_state = spy->decode_msg_info->disp_state;
+            view->disp_scroll = spy->decode_msg_info->disp_scroll;
+        }
+    }
+    pthread_mutex_unlock(&spy->ui_mutex);
+
+    view_update_channels(view, spy);
+}
+
+static void view_update_channels(view_t *view, spyinfo_t *spy)
+{
+    // only copy the channel list when it changed
+    if(__atomic_load_n(&spy->channels_gen, __ATOMIC_ACQUIRE) == view->channels_gen)
+        return;
+
+    timed_lock(&spy->channels_mutex, &spy->perf.channels_waits);
+    {
+        size_t n = spy->channels->len;
+        if(view->channels_alloc < n) {
+            view->channels_alloc = n * 2;
+            view->channels = realloc(view->channels, view->channels_alloc * sizeof(msg_info_t *));
+        }
+        memcpy(view->channels, spy->channels->pdata, n * sizeof(msg_info_t *));
+        view->num_channels = n;
+        view->channels_gen = spy->channels_gen;
+    }
+    pthread_mutex_unlock(&spy->channels_mutex);
+}
+
+static void display_overview(strbuf_t *out, spyinfo_t *spy, const view_t *view)
+{
+    int show_url = (spy->num_providers > 1);
+
+    strbuf_printf(out, "         %-28s\t%12s\t%8s\t%10s\t%10s\t%20s%s\n",
+           "Channel", "Num Messages", "Hz (ave)", "Bandwidth", "Total", "Latency ms 50/99/max",
+           show_url ? "\tURL" : "");
+    strbuf_printf(out, "   ------------------------------------------------------------------------------------------------------------------\n");
 
     DEBUG(5, "start-loop\n");
 
-    for(int i = 0; i < spy->names_array->len; i++) {
-        const char *channel = g_array_index(spy->names_array, const char *, i);
-        if(channel == NULL)
-            break;
+    msg_stats_t stats;
+    rate_summary_t rate;
+    uint64_t now = timestamp_now();
+    uint64_t total_msgs = 0;
+    uint64_t total_bytes = 0;
+    double total_bandwidth = 0.0;
+    for(int i = 0; i < view->num_channels; i++) {
+        msg_info_t *minfo = view->channels[i];
+        msg_info_get_stats(minfo, &stats);
+        rate_stats_get(&stats.rate, now, &rate);
+
+        // "   %3d)  %-28s\t%9lu\t%7.2f\t%10s\t%10s\n"
+        size_t start;
+        strbuf_append(out, "   ", 3);
+        start = out->len;
+        strbuf_append_u64(out, i);
+        strbuf_rjust(out, start, 3);
+        strbuf_append(out, ")  ", 3);
+        start = out->len;
+        strbuf_append_str(out, minfo->channel);
+        strbuf_ljust(out, start, 28);
+        append_u64_col(out, stats.num_msgs, 9);
+        strbuf_append_char(out, '\t');
+        start = out->len;
+        strbuf_append_double(out, rate.hz, 2);
+        strbuf_rjust(out, start, 7);
+        append_bytes_col(out, rate.bytes_per_sec, "/s", 10);
+        append_bytes_col(out, stats.num_bytes, "", 10);
+        append_latency_col(out, &stats.latency, 20);
+        if(show_url) {
+            strbuf_append_char(out, '\t');
+            strbuf_append_str(out, provider_name(minfo->provider));
+        }
+        strbuf_append_char(out, '\n');
 
-        msg_info_t *minfo = (msg_info_t *) g_hash_table_lookup(spy->minfo_hashtbl, channel);
-        assert(minfo != NULL);
-        float hz = msg_info_get_hz(minfo);
-        printf("   %3d)  %-28s\t%9"PRIu64"\t%7.2f\n", i, (char *)channel, minfo->num_msgs, hz);
+        total_msgs += stats.num_msgs;
+        total_bytes += stats.num_bytes;
+        total_bandwidth += rate.bytes_per_sec;
     }
 
-    printf("\n");
+    strbuf_printf(out, "   ------------------------------------------------------------------------------------------------------------------\n");
+    strbuf_printf(out, "         %-28s", "Total");
+    append_u64_col(out, total_msgs, 9);
+    strbuf_printf(out, "\t%7s", "");
+    append_bytes_col(out, total_bandwidth, "/s", 10);
+    append_bytes_col(out, total_bytes, "", 10);
+    strbuf_append_char(out, '\n');
+
+    strbuf_printf(out, "\n");
+
+    // per-url channel counts, the workers of every url are summed up
+    int num_workers = 0;
+    uint64_t num_stalls = 0;
+    for(int p = 0; p < spy->num_providers; p++) {
+        provider_t *provider = &spy->providers[p];
+        if(show_url) {
+            int num_channels = 0;
+            for(int i = 0; i < view->num_channels; i++)
+                num_channels += (view->channels[i]->provider == provider);
+            strbuf_printf(out, "   URL %s: %d channels\n", provider_name(provider), num_channels);
+        }
+        if(provider->pool != NULL) {
+            num_workers += work_pool_num_workers(provider->pool);
+            num_stalls += work_pool_num_stalls(provider->pool);
+        }
+    }
+    if(num_workers > 0)
+        strbuf_printf(out, "   Workers: %d, full queue waits: %"PRIu64"\n", num_workers, num_stalls);
+
+    flight_rec_t *recorder = spy->recorder;
+    if(recorder != NULL) {
+        strbuf_printf(out, "   Recording: ");
+        append_bytes(out, flight_rec_used(recorder));
+        strbuf_printf(out, " buffered, %u dumps (press 'd' to dump)\n",
+                      __atomic_load_n(&spy->num_dumps, __ATOMIC_RELAXED));
+    }
 
-    if(spy->is_selecting) {
-        printf("   Decode channel: ");
-        if(spy->decode_index != -1)
-            printf("%d", spy->decode_index);
-        fflush(stdout);
+    if(view->is_selecting) {
+        strbuf_printf(out, "   Decode channel: ");
+        if(view->decode_index != -1)
+            strbuf_printf(out, "%d", view->decode_index);
     }
 }
 
-static void display_decode(spyinfo_t *spy)
+static void display_decode(strbuf_t *out, spyinfo_t *spy, view_t *view)
 {
-    msg_info_t *minfo = spy->decode_msg_info;
-    const char *channel = spy->decode_msg_channel;
+    msg_info_t *minfo = view->decode_msg_info;
+    const char *channel = view->decode_msg_channel;
+
+    const lcmtype_metadata_t *metadata = msg_info_get_metadata(minfo);
+    void *msg = msg_info_get_msg(minfo, &metadata);
+
+    const char *typename = (metadata != NULL) ? metadata->typename : NULL;
+    int64_t hash = (metadata != NULL) ? metadata->typeinfo->get_hash() : 0;
+    strbuf_printf(out, "         Decoding %s (%s) %"PRIu64":   (press 'p' for timing details)\n",
+                  channel, typename, (uint64_t) hash);
+    if(spy->num_providers > 1)
+        strbuf_printf(out, "         on %s\n", provider_name(minfo->provider));
+
+    msg_stats_t stats;
+    rate_summary_t rate;
+    msg_info_get_stats(minfo, &stats);
+    rate_stats_get(&stats.rate, timestamp_now(), &rate);
+    strbuf_printf(out, "         %.2f Hz, period (ms): min %.3f  mean %.3f  max %.3f  stddev %.3f\n",
+           rate.hz, rate.dt_min, rate.dt_mean, rate.dt_max, rate.dt_stddev);
+
+    const char *time_field = __atomic_load_n(&minfo->time_field, __ATOMIC_ACQUIRE);
+    if(stats.latency.num_samples > 0) {
+        strbuf_printf(out, "         latency (ms) from '%s': p50 %.3f  p99 %.3f  max %.3f",
+                      time_field, stats.latency.p50 / 1000.0, stats.latency.p99 / 1000.0,
+                      stats.latency.max / 1000.0);
+        if(stats.latency.num_negative > 0)
+            strbuf_printf(out, "  (%"PRIu64" negative)", stats.latency.num_negative);
+        strbuf_append_char(out, '\n');
+    } else if(metadata != NULL && time_field == NULL) {
+        strbuf_printf(out, "         latency: no timestamp field (see --time-field)\n");
+    }
 
-    const char *typename = (minfo->metadata != NULL) ? minfo->metadata->typename : NULL;
-    int64_t hash = (minfo->metadata != NULL) ? minfo->metadata->typeinfo->get_hash() : 0;
-    printf("         Decoding %s (%s) %"PRIu64":\n", channel, typename, (uint64_t) hash);
+    strbuf_append_str(out, "         ");
+    append_bytes(out, rate.bytes_per_sec);
+    strbuf_append_str(out, "/s, ");
+    append_bytes(out, stats.num_bytes);
+    strbuf_append_str(out, " total, sizes:");
+    for(int i = 0; i < SIZE_HIST_BUCKETS; i++) {
+        if(stats.size_hist[i] == 0)
+            continue;
+        uint64_t lo = (i == 0) ? 0 : (1ull << (i-1));
+        strbuf_append_str(out, "  [");
+        append_bytes(out, lo);
+        strbuf_printf(out, "+]: %"PRIu64, stats.size_hist[i]);
+    }
+    strbuf_printf(out, "\n");
 
-    if(minfo->last_msg != NULL)
-        msg_display(spy->type_db, minfo->metadata, minfo->last_msg, &minfo->disp_state);
+    if(minfo->num_decodes > 0) {
+        strbuf_printf(out, "         decoded %"PRIu64" (%"PRIu64" in arena), %"PRIu64" allocations avoided, arena ",
+                      minfo->num_decodes, minfo->num_arena_decodes, minfo->allocs_avoided);
+        append_bytes(out, arena_capacity(&minfo->arena));
+        strbuf_append_char(out, '\n');
+    }
+
+    if(minfo->is_decode_failed)
+        strbuf_printf(out, "         the latest message failed to decode (%"PRIu64" failures)\n",
+                      minfo->num_decode_errors);
+
+    if(msg == NULL)
+        return;
+
+    // only the lines fitting on the screen are formatted, below the header
+    // (and the traversal lines of msg_display()), above the scrolling hint
+    size_t header_lines = count_lines(out) + 2;
+    size_t rows = (view->screen_rows > 0) ? view->screen_rows : DEFAULT_SCREEN_ROWS;
+    size_t page = (rows > header_lines + 2) ? rows - header_lines - 1 : 1;
+
+    size_t start = out->len;
+    msg_display_viewport_t viewport = { .first_line = view->disp_scroll, .num_lines = page };
+    size_t num_lines = msg_display(out, spy->type_db, metadata, msg, &view->disp_state,
+                                   &view->disp_cache, &viewport);
+
+    // the message got shorter than the scroll position: show its end
+    if(num_lines > 0 && viewport.first_line + page > num_lines && viewport.first_line > 0) {
+        strbuf_truncate(out, start);
+        viewport.first_line = (num_lines > page) ? num_lines - page : 0;
+        msg_display(out, spy->type_db, metadata, msg, &view->disp_state, &view->disp_cache, &viewport);
+    }
+
+    __atomic_store_n(&spy->decode_num_lines, num_lines, __ATOMIC_RELAXED);
+    __atomic_store_n(&spy->decode_page_lines, page, __ATOMIC_RELAXED);
+
+    if(num_lines > page) {
+        size_t last = viewport.first_line + page;
+        strbuf_printf(out, "   -- lines %zu-%zu of %zu (j/k, PgUp/PgDn, g/G to scroll) --\n",
+                      viewport.first_line + 1, (last < num_lines) ? last : num_lines, num_lines);
+    }
+}
+
+/* a sparkline of the values, scaled between their min and max
+   a nan or an inf has no level: it is left blank */
+static void append_sparkline(strbuf_t *out, const watch_snapshot_t *snap)
+{
+    static const char *levels[] = { "\u2581", "\u2582", "\u2583", "\u2584",
+                                    "\u2585", "\u2586", "\u2587", "\u2588" };
+    double range = snap->max - snap->min;
+    for(int i = 0; i < snap->count; i++) {
+        double v = snap->values[i];
+        if(!isfinite(v)) {
+            strbuf_append_char(out, ' ');
+            continue;
+        }
+        int level = 3;
+        if(range > 0.0 && isfinite(range))
+            level = (int) ((v - snap->min) / range * 7.0 + 0.5);
+        if(level < 0) level = 0;
+        if(level > 7) level = 7;
+        strbuf_append_str(out, levels[level]);
+    }
+}
+
+static void append_value_col(strbuf_t *out, double v, int width)
+{
+    strbuf_append_char(out, '\t');
+    size_t start = out->len;
+    strbuf_printf(out, "%.6g", v);
+    strbuf_rjust(out, start, width);
+}
+
+static void display_watch(strbuf_t *out, spyinfo_t *spy)
+{
+    strbuf_printf(out, "         %-32s\t%12s\t%12s\t%12s\t%12s\t   last %d values   (press 'w' to go back)\n",
+                  "Watch", "Value", "Min", "Mean", "Max", WATCH_HISTORY);
+    strbuf_printf(out, "   ------------------------------------------------------------------------------------------------------------------\n");
+
+    if(spy->num_watches == 0)
+        strbuf_printf(out, "         no watches, see '--watch CHANNEL.field'\n");
+
+    watch_snapshot_t snap;
+    for(int i = 0; i < spy->num_watches; i++) {
+        watch_t *w = spy->watches[i];
+        strbuf_append_str(out, "         ");
+        strbuf_append_column(out, watch_path(w), 32);
+
+        const char *error = watch_error(w);
+        watch_get(w, &snap);
+        if(snap.count == 0) {
+            strbuf_printf(out, "\t%12s\t%s\n", "-", (error != NULL) ? error : "no values yet");
+            continue;
+        }
+
+        append_value_col(out, snap.values[snap.count - 1], 12);
+        append_value_col(out, snap.min, 12);
+        append_value_col(out, snap.mean, 12);
+        append_value_col(out, snap.max, 12);
+        strbuf_append_str(out, "\t   ");
+        append_sparkline(out, &snap);
+        strbuf_append_char(out, '\n');
+    }
+}
+
+static void append_perf_row(strbuf_t *out, const char *label, const perf_counter_t *pc, double hz)
+{
+    strbuf_printf(out, "   %-36s\t%12"PRIu64, label, pc->count);
+    if(hz >= 0.0)
+        strbuf_printf(out, "\t%10.1f", hz);
+    else
+        strbuf_printf(out, "\t%10s", "");
+    double mean = (pc->count > 0) ? (double) pc->sum_ns / pc->count : 0.0;
+    strbuf_printf(out, "\t%10.2f\t%10.2f\n", mean / 1000.0, pc->max_ns / 1000.0);
+}
+
+#define MAX_PERF_TYPES 32
+
+/* the self-timing overlay: what lcm-spy-lite itself costs */
+static void display_perf(strbuf_t *out, spyinfo_t *spy, view_t *view)
+{
+    perf_counter_t pc;
+    char label[256];
+
+    uint64_t now = timestamp_now();
+    double dt = (now - view->perf_utime) / 1e6;
+    int update_rates = (dt >= 1.0);
+    if(update_rates)
+        view->perf_utime = now;
+
+    strbuf_printf(out, "\n   %-36s\t%12s\t%10s\t%10s\t%10s\n",
+                  "Self timing (press 'o' to hide)", "count", "per sec", "mean us", "max us");
+    strbuf_printf(out, "   ------------------------------------------------------------------------------------------------------------------\n");
+
+    for(int p = 0; p < spy->num_providers; p++) {
+        provider_t *provider = &spy->providers[p];
+        perf_counter_get(&provider->handler, &pc);
+        if(update_rates) {
+            view->handled_hz[p] = (pc.count - view->perf_prev_handled[p]) / dt;
+            view->perf_prev_handled[p] = pc.count;
+        }
+        snprintf(label, sizeof(label), "receive %s", provider_name(provider));
+        append_perf_row(out, label, &pc, view->handled_hz[p]);
+
+        if(provider->pool != NULL)
+            strbuf_printf(out, "   %-36s\tfullest worker queue %.1f%%, %"PRIu64" full queue waits\n", "",
+                          100.0 * work_pool_max_fill(provider->pool), work_pool_num_stalls(provider->pool));
+    }
+
+    // the decode cost per type, summed over its channels
+    const lcmtype_metadata_t *types[MAX_PERF_TYPES];
+    perf_counter_t decodes[MAX_PERF_TYPES];
+    int num_types = 0;
+    for(size_t i = 0; i < view->num_channels; i++) {
+        msg_info_t *minfo = view->channels[i];
+        const lcmtype_metadata_t *md = msg_info_get_metadata(minfo);
+        perf_counter_get(&minfo->decode_perf, &pc);
+        if(md == NULL || pc.count == 0)
+            continue;
+
+        int t = 0;
+        while(t < num_types && types[t] != md)
+            t++;
+        if(t == num_types) {
+            if(num_types == MAX_PERF_TYPES)
+                continue;
+            types[t] = md;
+            memset(&decodes[t], 0, sizeof(perf_counter_t));
+            num_types++;
+        }
+        decodes[t].count += pc.count;
+        decodes[t].sum_ns += pc.sum_ns;
+        if(pc.max_ns > decodes[t].max_ns)
+            decodes[t].max_ns = pc.max_ns;
+    }
+    for(int t = 0; t < num_types; t++) {
+        snprintf(label, sizeof(label), "decode %s", types[t]->typename);
+        append_perf_row(out, label, &decodes[t], -1.0);
+    }
+
+    perf_counter_get(&spy->perf.channels_waits, &pc);
+    append_perf_row(out, "lock wait: channels", &pc, -1.0);
+    perf_counter_get(&spy->perf.ui_waits, &pc);
+    append_perf_row(out, "lock wait: ui", &pc, -1.0);
+    if(spy->recorder != NULL) {
+        perf_counter_get(&spy->perf.recorder_waits, &pc);
+        append_perf_row(out, "lock wait: recorder", &pc, -1.0);
+    }
+
+    perf_counter_get(&spy->perf.frames, &pc);
+    if(update_rates) {
+        view->frames_hz = (pc.count - view->perf_prev_frames) / dt;
+        view->perf_prev_frames = pc.count;
+    }
+    append_perf_row(out, "frames", &pc, view->frames_hz);
+}
+
+static const double detail_percentiles[] = { 50.0, 90.0, 99.0, 99.9 };
+static const char *detail_percentile_names[] = { "p50", "p90", "p99", "p99.9" };
+#define NUM_DETAIL_PERCENTILES (sizeof(detail_percentiles) / sizeof(detail_percentiles[0]))
+
+/* "p50 .. p99.9 max" of a usec histogram, in msec */
+static void append_percentiles(strbuf_t *out, const char *label, const histogram_t *h)
+{
+    strbuf_printf(out, "   %-16s", label);
+    for(size_t i = 0; i < NUM_DETAIL_PERCENTILES; i++)
+        strbuf_printf(out, "\t%10.3f", histogram_percentile(h, detail_percentiles[i]) / 1000.0);
+    strbuf_printf(out, "\t%10.3f\t%10"PRIu64"\n", h->max / 1000.0, h->total);
+}
+
+static void display_detail(strbuf_t *out, spyinfo_t *spy, view_t *view)
+{
+    msg_info_t *minfo = view->decode_msg_info;
+    const lcmtype_metadata_t *metadata = msg_info_get_metadata(minfo);
+
+    strbuf_printf(out, "         Timing of %s (%s)", view->decode_msg_channel,
+                  (metadata != NULL) ? metadata->typename : "unknown type");
+    if(spy->num_providers > 1)
+        strbuf_printf(out, " on %s", provider_name(minfo->provider));
+    strbuf_printf(out, ":   (press 'p' or escape to go back)\n\n");
+
+    msg_stats_t stats;
+    msg_timing_t timing;
+    rate_summary_t rate;
+    msg_info_get_stats(minfo, &stats);
+    msg_info_get_timing(minfo, &timing);
+    rate_stats_get(&stats.rate, timestamp_now(), &rate);
+
+    strbuf_printf(out, "   %-16s", "(ms)");
+    for(size_t i = 0; i < NUM_DETAIL_PERCENTILES; i++)
+        strbuf_printf(out, "\t%10s", detail_percentile_names[i]);
+    strbuf_printf(out, "\t%10s\t%10s\n", "max", "samples");
+    strbuf_printf(out, "   ------------------------------------------------------------------------------------------------------\n");
+
+    append_percentiles(out, "period", &timing.period);
+    if(timing.latency.total > 0)
+        append_percentiles(out, "latency", &timing.latency);
+    strbuf_printf(out, "\n");
+
+    // the gaps are counted at display time, so the threshold costs nothing per message
+    uint64_t threshold = spy->gap_threshold;
+    const char *how = "";
+    if(threshold == 0) {
+        threshold = 2 * histogram_percentile(&timing.period, 50.0);
+        how = ", twice the median";
+    }
+    uint64_t num_gaps = histogram_count_above(&timing.period, threshold);
+    strbuf_printf(out, "   gaps over %.3f ms%s: %"PRIu64, threshold / 1000.0, how, num_gaps);
+    if(timing.period.total > 0)
+        strbuf_printf(out, " (%.3f%%)", 100.0 * num_gaps / timing.period.total);
+    strbuf_printf(out, "\n");
+    strbuf_printf(out, "   recent: %.2f Hz, period (ms) min %.3f  mean %.3f  max %.3f  stddev %.3f\n",
+                  rate.hz, rate.dt_min, rate.dt_mean, rate.dt_max, rate.dt_stddev);
+}
+
+#define IDLE_PERIOD (1000*1000)  /* redraw at least once per second */
+
+/* called by the lcm thread when a channel got data: never blocks */
+static inline void mark_dirty(spyinfo_t *spy, msg_info_t *minfo)
+{
+    msg_info_t *visible = __atomic_load_n(&spy->visible_channel, __ATOMIC_ACQUIRE);
+    if(visible != NULL && visible != minfo)
+        return;
+
+    // only the first change after a frame needs to wake up an idle print
+    // thread. It checks 'is_dirty' and waits under ui_mutex: signalling
+    // under it too means it is either still to check, or already waiting
+    if(__atomic_exchange_n(&spy->is_dirty, 1, __ATOMIC_SEQ_CST) == 0 &&
+       __atomic_load_n(&spy->is_idle, __ATOMIC_SEQ_CST)) {
+        timed_lock(&spy->ui_mutex, &spy->perf.ui_waits);
+        pthread_cond_signal(&spy->redraw_cond);
+        pthread_mutex_unlock(&spy->ui_mutex);
+    }
+}
+
+/* wait until the view is dirty, or for at most 'timeout' usec
+   returns non-zero if the view is dirty */
+static int wait_for_redraw(spyinfo_t *spy, uint64_t timeout)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout / 1000000;
+    deadline.tv_nsec += (timeout % 1000000) * 1000;
+    if(deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    int is_dirty;
+    timed_lock(&spy->ui_mutex, &spy->perf.ui_waits);
+    {
+        __atomic_store_n(&spy->is_idle, 1, __ATOMIC_SEQ_CST);
+        while(!quit && !(is_dirty = __atomic_load_n(&spy->is_dirty, __ATOMIC_SEQ_CST))) {
+            if(pthread_cond_timedwait(&spy->redraw_cond, &spy->ui_mutex, &deadline) != 0)
+                break;
+        }
+        __atomic_store_n(&spy->is_idle, 0, __ATOMIC_SEQ_CST);
+    }
+    pthread_mutex_unlock(&spy->ui_mutex);
+
+    return is_dirty;
 }
 
 void *print_thread_func(void *arg)
@@ -460,97 +1545,390 @@ void *print_thread_func(void *arg)
 
     period = 1000000 / hz;
 
+    view_t view = {0};
+    view.channels_gen = (uint32_t) -1;
+
+    // frames are built in memory, and only their changes are sent to the terminal
+    strbuf_t frame;
+    strbuf_t overlay;
+    strbuf_init(&frame);
+    strbuf_init(&overlay);
+    term_render_t *render = term_render_create(STDOUT_FILENO);
+
+    // terminal output rate, updated every second
+    uint64_t out_utime = timestamp_now();
+    uint64_t out_bytes = 0;
+    double out_rate = 0.0;
+
+    // how long to wait for changes before redrawing anyway
+    uint64_t backoff = period;
+
     DEBUG(1, "INFO: %s: Starting\n", "print_thread");
     while (!quit) {
+        // never redraw faster than the display rate
         usleep(period);
 
-        clearscreen();
-        printf("  **************************************************************************** \n");
-        printf("  ************************** LCM-SPY (lite) [%3.1f Hz] ************************ \n", hz);
-        printf("  **************************************************************************** \n");
+        if(wait_for_redraw(spy, backoff)) {
+            backoff = period;
+        } else {
+            backoff *= 2;
+            if(backoff > IDLE_PERIOD)
+                backoff = IDLE_PERIOD;
+        }
 
-        pthread_mutex_lock(&spy->mutex);
-        {
-            switch(spy->mode) {
+        if(quit)
+            break;
 
-                case MODE_OVERVIEW:
-                    display_overview(spy);
-                    break;
+        ss_timer_t frame_timer;
+        tmr_tic(&frame_timer);
 
-                case MODE_DECODE:
-                    display_decode(spy);
-                    break;
+        // changes from now on will be in the next frame
+        __atomic_store_n(&spy->is_dirty, 0, __ATOMIC_SEQ_CST);
+        view_update(&view, spy);
 
-                default:
-                    DEBUG(1, "ERR: unknown mode\n");
-            }
+        uint64_t now = timestamp_now();
+        if(now - out_utime >= 1000000) {
+            uint64_t bytes = term_render_get_bytes_written(render);
+            out_rate = (bytes - out_bytes) / ((now - out_utime) / 1000000.0);
+            out_bytes = bytes;
+            out_utime = now;
+        }
+
+        // the overlay goes below the screen, which gets the rows it leaves
+        int rows, cols;
+        term_render_get_size(render, &rows, &cols);
+        strbuf_clear(&overlay);
+        if(view.show_perf)
+            display_perf(&overlay, spy, &view);
+        view.screen_rows = rows - count_lines(&overlay);
+        if(rows > 0 && view.screen_rows < 1)
+            view.screen_rows = 1;
+
+        strbuf_t *out = &frame;
+        strbuf_clear(out);
+        strbuf_printf(out, "  **************************************************************************** \n");
+        strbuf_printf(out, "  ******************* LCM-SPY (lite) [%3.1f Hz, out: ", hz);
+        append_bytes(out, out_rate);
+        strbuf_printf(out, "/s] ******************* \n");
+        strbuf_printf(out, "  **************************************************************************** \n");
+
+        switch(view.mode) {
+
+            case MODE_OVERVIEW:
+                display_overview(out, spy, &view);
+                break;
+
+            case MODE_DECODE:
+                display_decode(out, spy, &view);
+                break;
+
+            case MODE_DETAIL:
+                display_detail(out, spy, &view);
+                break;
+
+            case MODE_WATCH:
+                display_watch(out, spy);
+                break;
+
+            default:
+                DEBUG(1, "ERR: unknown mode\n");
         }
-        pthread_mutex_unlock(&spy->mutex);
 
-        // flush the stdout buffer (required since we use full buffering)
-        fflush(stdout);
+        strbuf_append(out, overlay.data, overlay.len);
+
+        term_render_frame(render, frame.data, frame.len);
+        perf_counter_add(&spy->perf.frames, tmr_toc(&frame_timer));
     }
 
+    term_render_destroy(render);
+    strbuf_cleanup(&frame);
+    strbuf_cleanup(&overlay);
+    free(view.channels);
+
     DEBUG(1, "INFO: %s: Ending\n", "print_thread");
 
     return NULL;
 }
 
+//////////////////////////////////////////////////////////////////////
+//////////////////////////// Stats Thread ////////////////////////////
+//////////////////////////////////////////////////////////////////////
+
+#define STATS_COST_REPORT_PERIOD (10*1000*1000)  /* log the emit cost every 10s */
+
+void *stats_thread_func(void *arg)
+{
+    spyinfo_t *spy = (spyinfo_t *)arg;
+    stats_writer_t *writer = spy->stats_writer;
+    uint64_t period = spy->stats_interval * 1000000;
+
+    view_t view = {0};
+    view.channels_gen = (uint32_t) -1;
+
+    // what emitting costs, reported to the debug log
+    uint64_t cost_utime = timestamp_now();
+    uint64_t cost_sum = 0;
+    uint64_t cost_max = 0;
+    uint64_t cost_channels = 0;
+    uint64_t num_emits = 0;
+
+    DEBUG(1, "INFO: %s: Starting\n", "stats_thread");
+    uint64_t next = timestamp_now() + period;
+    while(!quit) {
+        uint64_t now = timestamp_now();
+        if(now < next) {
+            uint64_t left = next - now;
+            usleep(left < SELECT_TIMEOUT ? left : SELECT_TIMEOUT);
+            continue;
+        }
+
+        // keep a steady cadence, but don't try to catch up after a stall
+        next += period;
+        if(next <= now)
+            next = now + period;
+
+        view_update_channels(&view, spy);
+
+        msg_stats_t stats;
+        rate_summary_t rate;
+        stats_writer_begin(writer, now);
+        for(size_t i = 0; i < view.num_channels; i++) {
+            msg_info_t *minfo = view.channels[i];
+            msg_info_get_stats(minfo, &stats);
+            rate_stats_get(&stats.rate, now, &rate);
+
+            const lcmtype_metadata_t *metadata = msg_info_get_metadata(minfo);
+            stats_record_t rec = {
+                .channel = minfo->channel,
+                .url = minfo->provider->url,
+                .typename = (metadata != NULL) ? metadata->typename : NULL,
+                .hash = __atomic_load_n(&minfo->hash, __ATOMIC_RELAXED),
+                .num_msgs = stats.num_msgs,
+                .num_bytes = stats.num_bytes,
+                .hz = rate.hz,
+                .bytes_per_sec = rate.bytes_per_sec
+            };
+            stats_writer_add(writer, &rec);
+        }
+
+        if(stats_writer_flush(writer) != 0) {
+            DEBUG(1, "ERR: failed to write stats, stopping\n");
+            quit = 1;
+            break;
+        }
+
+        uint64_t cost = timestamp_now() - now;
+        cost_sum += cost;
+        if(cost > cost_max)
+            cost_max = cost;
+        cost_channels += view.num_channels;
+        num_emits++;
+
+        if(now - cost_utime >= STATS_COST_REPORT_PERIOD) {
+            DEBUG(1, "INFO: stats emit: %"PRIu64" emits, mean %.1f us, max %"PRIu64" us, %.0f ns/channel\n",
+                  num_emits, (double) cost_sum / num_emits, cost_max,
+                  cost_channels ? 1000.0 * cost_sum / cost_channels : 0.0);
+            cost_utime = now;
+            cost_sum = cost_max = cost_channels = num_emits = 0;
+        }
+    }
+
+    free(view.channels);
+
+    DEBUG(1, "INFO: %s: Ending\n", "stats_thread");
+    return NULL;
+}
+
 //////////////////////////////////////////////////////////////////////
 ///////////////////////////// LCM HANDLER ////////////////////////////
 //////////////////////////////////////////////////////////////////////
 
-static gint names_array_cmp(gconstpointer a, gconstpointer b)
+static gint channels_cmp(gconstpointer a, gconstpointer b)
 {
-    return strcmp(*(const char **)a, *(const char **)b);
+    const msg_info_t *ma = *(const msg_info_t **)a;
+    const msg_info_t *mb = *(const msg_info_t **)b;
+    int cmp = strcmp(ma->channel, mb->channel);
+    if(cmp != 0)
+        return cmp;
+    return ma->provider->index - mb->provider->index;
+}
+
+/* finds or creates the msg_info of 'channel', provider's lcm thread only */
+static msg_info_t *get_msg_info(provider_t *provider, const char *channel)
+{
+    spyinfo_t *spy = provider->spy;
+    msg_info_t *minfo;
+
+    /* only this thread modifies the hashtable, so no lock is needed to read it */
+    minfo = (msg_info_t *) g_hash_table_lookup(provider->minfo_hashtbl, channel);
+    if (minfo == NULL) {
+        char *channel_copy = strdup(channel);
+        minfo = msg_info_create(provider, channel_copy);
+        minfo->shard = provider->num_shards_assigned++;
+        minfo->is_excluded = ((spy->include_regex != NULL &&
+                               !g_regex_match(spy->include_regex, channel, 0, NULL)) ||
+                              (spy->exclude_regex != NULL &&
+                               g_regex_match(spy->exclude_regex, channel, 0, NULL)));
+        minfo->is_stats_only = (spy->stats_only_regex != NULL &&
+                                g_regex_match(spy->stats_only_regex, channel, 0, NULL));
+        minfo->is_recorded = (spy->recorder != NULL && !minfo->is_excluded &&
+                              (spy->record_regex == NULL ||
+                               g_regex_match(spy->record_regex, channel, 0, NULL)));
+        g_hash_table_insert(provider->minfo_hashtbl, channel_copy, minfo);
+
+        // before the first message is dispatched, the worker then owns them
+        for(int i = 0; i < spy->num_watches && !minfo->is_excluded; i++) {
+            if(!watch_bind(spy->watches[i], minfo->channel))
+                continue;
+            DEBUG(1, "INFO: watching '%s' on channel '%s'\n", watch_path(spy->watches[i]), channel);
+            minfo->watches = realloc(minfo->watches, (minfo->num_watches + 1) * sizeof(watch_t *));
+            minfo->watches[minfo->num_watches++] = spy->watches[i];
+        }
+
+        // excluded channels stay in the hashtable, so they are only matched once
+        if(minfo->is_excluded) {
+            DEBUG(2, "INFO: excluding channel '%s'\n", channel);
+            return minfo;
+        }
+
+        timed_lock(&spy->channels_mutex, &spy->perf.channels_waits);
+        {
+            g_ptr_array_add(spy->channels, minfo);
+            g_ptr_array_sort(spy->channels, channels_cmp);
+            __atomic_add_fetch(&spy->channels_gen, 1, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&spy->channels_mutex);
+    }
+
+    return minfo;
+}
+
+/* everything done per message, on the channel's worker (or inline) */
+static void handle_msg(void *usr, const work_msg_t *msg)
+{
+    spyinfo_t *spy = (spyinfo_t *)usr;
+    msg_info_t *minfo = msg->ctx;
+
+    msg_info_add_msg(minfo, msg->utime, msg->data, msg->size);
+
+    // failures are counted in 'num_decode_errors'
+    if(spy->decode_all && minfo->metadata != NULL)
+        msg_info_decode(minfo, minfo->metadata, msg->data, msg->size);
+
+    mark_dirty(spy, minfo);
+}
+
+/* hands a message to the channel's worker, or handles it right away
+   without workers. 'copy' is needed unless 'data' outlives the handling */
+static inline void dispatch_msg(provider_t *provider, msg_info_t *minfo, int64_t utime,
+                                const void *data, uint32_t size, int copy)
+{
+    if(provider->pool != NULL) {
+        work_pool_submit(provider->pool, minfo->shard, minfo, utime, data, size, copy);
+    } else {
+        work_msg_t msg = { .ctx = minfo, .utime = utime, .data = data, .size = size };
+        handle_msg(provider->spy, &msg);
+    }
 }
 
 void handler_all_lcm (const lcm_recv_buf_t *rbuf,
                       const char *channel, void *arg)
 {
-    spyinfo_t *spy = (spyinfo_t *)arg;
-    msg_info_t *minfo;
+    provider_t *provider = (provider_t *)arg;
+    spyinfo_t *spy = provider->spy;
     uint64_t utime = timestamp_now();
+    ss_timer_t timer;
+    tmr_tic(&timer);
 
-    pthread_mutex_lock(&spy->mutex);
-    {
-        minfo = (msg_info_t *) g_hash_table_lookup(spy->minfo_hashtbl, channel);
-        if (minfo == NULL) {
-            char *channel_copy = strdup(channel);
-            minfo = msg_info_create(spy, channel_copy);
-            g_array_append_val(spy->names_array, channel_copy);
-            g_array_sort(spy->names_array, names_array_cmp);
-            g_hash_table_insert(spy->minfo_hashtbl, channel_copy, minfo);
-        }
+    msg_info_t *minfo = get_msg_info(provider, channel);
+    if(minfo->is_excluded)
+        return;
 
-        msg_info_add_msg(minfo, utime, rbuf);
+    dispatch_msg(provider, minfo, utime, rbuf->data, rbuf->data_size, 1);
+    if(minfo->is_recorded) {
+        timed_lock(&spy->recorder_mutex, &spy->perf.recorder_waits);
+        flight_rec_append(spy->recorder, minfo->channel, minfo->channel_len,
+                          utime, rbuf->data, rbuf->data_size);
+        pthread_mutex_unlock(&spy->recorder_mutex);
     }
-    pthread_mutex_unlock(&spy->mutex);
+
+    perf_counter_add(&provider->handler, tmr_toc(&timer));
 }
 
-void *lcm_thread_func(void *usr)
+/* writes the flight recorder to a new "<record file>-<date>.lcm" log
+   returns the number of messages written, or -1 on error */
+static int64_t dump_recorder(spyinfo_t *spy, char *filename, size_t filename_size)
+{
+    char date[32];
+    time_t t = time(NULL);
+    struct tm tm;
+    strftime(date, sizeof(date), "%Y%m%d-%H%M%S", localtime_r(&t, &tm));
+    snprintf(filename, filename_size, "%s-%s.lcm", spy->record_filename, date);
+
+    uint64_t start = timestamp_now();
+    int64_t n = flight_rec_dump(spy->recorder, filename);
+    if(n < 0) {
+        DEBUG(1, "ERR: failed to dump the flight recorder to %s\n", filename);
+        return -1;
+    }
+
+    __atomic_add_fetch(&spy->num_dumps, 1, __ATOMIC_RELAXED);
+    DEBUG(1, "INFO: dumped %"PRId64" messages to %s in %"PRIu64" us\n",
+          n, filename, timestamp_now() - start);
+    return n;
+}
+
+/* dumps the flight recorder on request, so that writing hundreds of MB
+   never holds up lcm_handle() */
+void *dump_thread_func(void *usr)
 {
     spyinfo_t *spy = (spyinfo_t *) usr;
 
-    DEBUG(1, "INFO: %s: Starting\n", "lcm_thread");
+    DEBUG(1, "INFO: %s: Starting\n", "dump_thread");
+
+    while(!quit) {
+        if(__atomic_exchange_n(&dump_requested, 0, __ATOMIC_ACQ_REL)) {
+            char filename[1024];
+            dump_recorder(spy, filename, sizeof(filename));
+        } else {
+            usleep(SELECT_TIMEOUT);
+        }
+    }
+
+    DEBUG(1, "INFO: %s: Ending\n", "dump_thread");
+    return NULL;
+}
+
+void *lcm_thread_func(void *usr)
+{
+    provider_t *provider = (provider_t *) usr;
+    spyinfo_t *spy = provider->spy;
+
+    DEBUG(1, "INFO: %s: Starting for %s\n", "lcm_thread", provider_name(provider));
 
     // lcm setup
     lcm_t *lcm = NULL;
     lcm_subscription_t *lcm_all = NULL;
 
-    lcm = lcm_create(NULL);
+    lcm = lcm_create(provider->url);
     if(lcm == NULL) {
-        DEBUG(1, "ERR: failed to create an lcm object!\n");
+        DEBUG(1, "ERR: failed to create an lcm object for %s!\n", provider_name(provider));
+        fprintf(stderr, "ERR: failed to create an lcm object for %s\n", provider_name(provider));
         quit = 1;
         goto done;
     }
 
-    lcm_all = lcm_subscribe(lcm, ".*", handler_all_lcm, spy);
+    // the include filter is applied by lcm itself, excluded channels are never delivered
+    const char *pattern = (spy->include_pattern != NULL) ? spy->include_pattern : ".*";
+    lcm_all = lcm_subscribe(lcm, pattern, handler_all_lcm, provider);
     if(lcm_all == NULL) {
-        DEBUG(1, "ERR: failed to create an subscibe to all\n");
+        DEBUG(1, "ERR: failed to subscribe to '%s'\n", pattern);
+        fprintf(stderr, "ERR: failed to subscribe to '%s'\n", pattern);
         quit = 1;
         goto done;
     }
+    if(spy->queue_capacity > 0)
+        lcm_subscription_set_queue_capacity(lcm_all, spy->queue_capacity);
 
     // all is good, lets handle it...
     while(!quit) {
@@ -567,7 +1945,7 @@ void *lcm_thread_func(void *usr)
         if(quit)
             break;
 
-        if(status != 0 && FD_ISSET(lcm_fd, &fds)) {
+        if(status > 0 && FD_ISSET(lcm_fd, &fds)) {
             int err = lcm_handle(lcm);
             if (err) {
                 DEBUG(1, "ERR: lcm_handle() returned an error\n");
@@ -587,6 +1965,158 @@ void *lcm_thread_func(void *usr)
     return NULL;
 }
 
+//////////////////////////////////////////////////////////////////////
+///////////////////////////// LOG REPLAY /////////////////////////////
+//////////////////////////////////////////////////////////////////////
+
+#define MAX_CHANNEL_LEN 1024
+
+/* feeds every event of an lcm log through the lcm thread's code path,
+   as fast as it can be read. Timestamps come from the log, so rates are
+   those of the recording. Returns the number of events, or -1 on error */
+static int64_t replay_log(provider_t *provider, lcm_log_reader_t *reader)
+{
+    char channel[MAX_CHANNEL_LEN];
+    int64_t num_events = 0;
+    // a windowed log is unmapped as the reader moves on, the workers need a copy
+    int copy = !lcm_log_reader_is_stable(reader);
+
+    lcm_log_event_t ev;
+    while(!quit && lcm_log_reader_next(reader, &ev)) {
+        if(ev.channellen >= MAX_CHANNEL_LEN) {
+            DEBUG(1, "WRN: skipping event %"PRId64": channel name too long\n", ev.eventnum);
+            continue;
+        }
+        memcpy(channel, ev.channel, ev.channellen);
+        channel[ev.channellen] = '\0';
+
+        msg_info_t *minfo = get_msg_info(provider, channel);
+        if(minfo->is_excluded)
+            continue;
+        dispatch_msg(provider, minfo, ev.timestamp, ev.data, ev.datalen, copy);
+
+        num_events++;
+    }
+
+    if(provider->pool != NULL)
+        work_pool_drain(provider->pool);
+    return num_events;
+}
+
+/* the whole-log counterpart of the overview screen */
+static void print_log_summary(strbuf_t *out, spyinfo_t *spy, int do_decode)
+{
+    strbuf_printf(out, "   %-28s\t%-24s\t%12s\t%8s\t%10s\t%10s",
+                  "Channel", "Type", "Num Messages", "Hz (ave)", "Bandwidth", "Total");
+    if(do_decode)
+        strbuf_printf(out, "\t%10s", "Decode Err");
+    strbuf_append_char(out, '\n');
+
+    msg_stats_t stats;
+    for(size_t i = 0; i < spy->channels->len; i++) {
+        msg_info_t *minfo = g_ptr_array_index(spy->channels, i);
+        msg_info_get_stats(minfo, &stats);
+
+        // averages over the channel's own span of the log
+        double span = (stats.rate.last_utime - stats.rate.first_utime) / 1e6;
+        double hz = (span > 0) ? (stats.num_msgs - 1) / span : 0.0;
+        double bytes_per_sec = (span > 0) ? stats.num_bytes / span : 0.0;
+
+        const lcmtype_metadata_t *md = minfo->metadata;
+        size_t start;
+        strbuf_append(out, "   ", 3);
+        start = out->len;
+        strbuf_append_str(out, minfo->channel);
+        strbuf_ljust(out, start, 28);
+        strbuf_append_char(out, '\t');
+        start = out->len;
+        if(md != NULL) {
+            strbuf_append_str(out, md->typename);
+        } else {
+            strbuf_printf(out, "? (0x%016"PRIx64")", (uint64_t) minfo->hash);
+        }
+        strbuf_ljust(out, start, 24);
+        append_u64_col(out, stats.num_msgs, 12);
+        strbuf_append_char(out, '\t');
+        start = out->len;
+        strbuf_append_double(out, hz, 2);
+        strbuf_rjust(out, start, 8);
+        append_bytes_col(out, bytes_per_sec, "/s", 10);
+        append_bytes_col(out, stats.num_bytes, "", 10);
+        if(do_decode)
+            append_u64_col(out, minfo->num_decode_errors, 10);
+        strbuf_append_char(out, '\n');
+    }
+}
+
+/* returns the process exit status */
+static int analyze_log(spyinfo_t *spy, const char *filename, int do_decode)
+{
+    lcm_log_reader_t *reader = lcm_log_reader_open(filename);
+    if(reader == NULL)
+        return 1;
+
+    uint64_t start = timestamp_now();
+    spy->decode_all = do_decode;
+    int64_t num_events = replay_log(&spy->providers[0], reader);
+    double elapsed = (timestamp_now() - start) / 1e6;
+    uint64_t size = lcm_log_reader_size(reader);
+
+    strbuf_t out;
+    strbuf_init(&out);
+
+    if(spy->stats_writer != NULL) {
+        // machine readable: one record per channel, as of the end of the log
+        uint64_t end_utime = 0;
+        for(size_t i = 0; i < spy->channels->len; i++) {
+            msg_info_t *minfo = g_ptr_array_index(spy->channels, i);
+            if(minfo->stats.rate.last_utime > end_utime)
+                end_utime = minfo->stats.rate.last_utime;
+        }
+
+        stats_writer_begin(spy->stats_writer, end_utime);
+        msg_stats_t stats;
+        for(size_t i = 0; i < spy->channels->len; i++) {
+            msg_info_t *minfo = g_ptr_array_index(spy->channels, i);
+            msg_info_get_stats(minfo, &stats);
+            double span = (stats.rate.last_utime - stats.rate.first_utime) / 1e6;
+            const lcmtype_metadata_t *md = minfo->metadata;
+            stats_record_t rec = {
+                .channel = minfo->channel,
+                .url = minfo->provider->url,
+                .typename = (md != NULL) ? md->typename : NULL,
+                .hash = minfo->hash,
+                .num_msgs = stats.num_msgs,
+                .num_bytes = stats.num_bytes,
+                .hz = (span > 0) ? (stats.num_msgs - 1) / span : 0.0,
+                .bytes_per_sec = (span > 0) ? stats.num_bytes / span : 0.0
+            };
+            stats_writer_add(spy->stats_writer, &rec);
+        }
+        stats_writer_flush(spy->stats_writer);
+    } else {
+        strbuf_printf(&out, "   Log %s: %"PRId64" events, ", filename, num_events);
+        append_bytes(&out, size);
+        strbuf_printf(&out, " in %.2f s (", elapsed);
+        append_bytes(&out, elapsed > 0 ? size / elapsed : 0.0);
+        strbuf_printf(&out, "/s)");
+        if(lcm_log_reader_skipped(reader) > 0) {
+            strbuf_printf(&out, ", skipped ");
+            append_bytes(&out, lcm_log_reader_skipped(reader));
+            strbuf_printf(&out, " of corrupt data");
+        }
+        strbuf_printf(&out, "\n\n");
+        print_log_summary(&out, spy, do_decode);
+        fwrite(out.data, 1, out.len, stdout);
+    }
+
+    DEBUG(1, "INFO: replayed %"PRId64" events in %.3f s\n", num_events, elapsed);
+
+    strbuf_cleanup(&out);
+    lcm_log_reader_close(reader);
+    return 0;
+}
+
 //////////////////////////////////////////////////////////////////////
 ////////////////////////////////// MAIN //////////////////////////////
 //////////////////////////////////////////////////////////////////////
@@ -600,20 +2130,397 @@ static void sighandler(int s)
             DEBUG(1, "Caught signal...\n");
             quit = 1;
             break;
+        case SIGUSR1:
+            dump_requested = 1;
+            break;
+        case SIGWINCH:
+            resize_requested = 1;
+            break;
         default:
             DEBUG(1, "WRN: unrecognized signal fired\n");
             break;
     }
 }
 
+/* long options without a short form */
+enum { OPT_RECORD_SIZE = 256, OPT_RECORD_CHANNELS, OPT_DUMP, OPT_NO_PIN,
+       OPT_INCLUDE, OPT_EXCLUDE, OPT_STATS_ONLY, OPT_QUEUE_CAPACITY, OPT_TIME_FIELD,
+       OPT_GAP, OPT_WATCH };
+
+#define MAX_WATCHES 64
+
+#define MAX_CHANNEL_PATTERNS 32
+
+/* joins channel patterns into a single alternation, so a channel matching
+   several of them is still delivered once. Returns a malloc()'ed string,
+   or NULL without patterns */
+static char *join_channel_patterns(const char **patterns, int n)
+{
+    if(n == 0)
+        return NULL;
+    if(n == 1)
+        return strdup(patterns[0]);
+
+    size_t len = 3;
+    for(int i = 0; i < n; i++)
+        len += strlen(patterns[i]) + 3;
+
+    char *joined = malloc(len);
+    char *w = joined;
+    *w++ = '(';
+    for(int i = 0; i < n; i++)
+        w += sprintf(w, "%s(%s)", (i > 0) ? "|" : "", patterns[i]);
+    *w++ = ')';
+    *w = '\0';
+    return joined;
+}
+
+/* compiles a joined pattern with the semantics of lcm subscriptions: the
+   whole channel name must match. Returns NULL on error (or without a pattern) */
+static GRegex *compile_channel_regex(const char *pattern, const char *option, int *err)
+{
+    if(pattern == NULL)
+        return NULL;
+
+    char *anchored = malloc(strlen(pattern) + 8);
+    sprintf(anchored, "^(?:%s)$", pattern);
+
+    GError *gerr = NULL;
+    GRegex *regex = g_regex_new(anchored, 0, 0, &gerr);
+    free(anchored);
+    if(regex == NULL) {
+        fprintf(stderr, "ERR: invalid %s regex '%s': %s\n", option, pattern, gerr->message);
+        g_error_free(gerr);
+        *err = 1; /* true */
+    }
+    return regex;
+}
+
+
+static void free_channel_filters(spyinfo_t *spy)
+{
+    if(spy->record_regex != NULL)     g_regex_unref(spy->record_regex);
+    if(spy->include_regex != NULL)    g_regex_unref(spy->include_regex);
+    if(spy->exclude_regex != NULL)    g_regex_unref(spy->exclude_regex);
+    if(spy->stats_only_regex != NULL) g_regex_unref(spy->stats_only_regex);
+    free(spy->include_pattern);
+}
+
+/* the type cache belongs in a private directory, not in the world-writable
+   /tmp: $XDG_CACHE_HOME (ignored unless absolute, like the XDG spec says)
+   or ~/.cache, created if needed. Returns NULL (no cache) if neither works */
+static char *default_cache_filename(void)
+{
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    const char *fmt;
+    const char *base;
+    if(xdg != NULL && xdg[0] == '/') {
+        fmt = "%s";
+        base = xdg;
+    } else if(home != NULL && home[0] != '\0') {
+        fmt = "%s/.cache";
+        base = home;
+    } else {
+        return NULL;
+    }
+
+    size_t sz = strlen(base) + sizeof("/.cache/") + sizeof(CACHE_BASENAME);
+    char *filename = malloc(sz);
+    snprintf(filename, sz, fmt, base);
+    if(mkdir(filename, 0700) != 0 && errno != EEXIST) {
+        DEBUG(1, "WRN: cannot create the cache directory '%s', no type cache\n", filename);
+        free(filename);
+        return NULL;
+    }
+
+    size_t len = strlen(filename);
+    snprintf(filename + len, sz - len, "/%s", CACHE_BASENAME);
+    return filename;
+}
+
+static void usage(const char *progname)
+{
+    fprintf(stderr, "usage: %s [options]\n"
+            "\n"
+            "  -u, --url URL           listen to the lcm url URL, may be repeated to monitor several\n"
+            "                          networks at once (default: lcm's default url)\n"
+            "  -s, --stats             headless: no terminal ui, periodically write channel stats\n"
+            "  -i, --interval SECONDS  time between stats records (default: 1)\n"
+            "  -f, --format FORMAT     stats format: 'jsonl' (default) or 'csv'\n"
+            "  -o, --output FILE       append the stats to FILE instead of stdout\n"
+            "  -l, --log FILE          summarize an lcm log file instead of live traffic\n"
+            "  -D, --decode            with --log: also decode every message, counting failures\n"
+            "  -r, --record FILE       keep the latest messages in the ring file FILE, dump them\n"
+            "                          as an lcm log with the 'd' key or SIGUSR1\n"
+            "      --record-size MB    size of the ring (default: %d)\n"
+            "      --record-channels REGEX  only record the matching channels\n"
+            "      --dump              with --record: dump the ring (e.g. after a crash) and exit\n"
+            "  -w, --workers N         handle messages on N worker threads, sharded by channel\n"
+            "                          (default: 0, everything on the receive thread)\n"
+            "      --no-pin            don't pin the workers to cores\n"
+            "      --include REGEX     only subscribe to the matching channels\n"
+            "      --exclude REGEX     ignore the matching channels\n"
+            "      --stats-only REGEX  only count the matching channels, never decode them\n"
+            "                          (the three filters above may be repeated)\n"
+            "      --queue-capacity N  messages lcm may queue for spy-lite (default: lcm's)\n"
+            "      --time-field [TYPE=]FIELD  the int64 usec timestamp latencies are measured\n"
+            "                          from, for TYPE or by default (default: '" DEFAULT_TIME_FIELD "')\n"
+            "      --watch PATH        plot the numeric field PATH, e.g. 'POSE.pos[2]', in the\n"
+            "                          watch screen ('w'), may be repeated\n"
+            "      --gap MS            count the inter-arrival times above MS as gaps\n"
+            "                          (default: above twice the channel's median)\n"
+            "      --debug             print the lcmtype loading details and exit\n"
+            "  -h, --help              show this help\n",
+            progname, DEFAULT_RECORD_SIZE_MB);
+}
+
 int main(int argc, char *argv[])
 {
     DEBUG_INIT();
     int is_debug_mode = 0; /* false */
+    int is_headless = 0; /* false */
+    double stats_interval = 1.0;
+    enum stats_format stats_format = STATS_FORMAT_JSONL;
+    const char *stats_filename = NULL;
+    const char *log_filename = NULL;
+    int log_decode = 0; /* false */
+    const char *record_filename = NULL;
+    uint64_t record_size = DEFAULT_RECORD_SIZE_MB;
+    const char *record_channels = NULL;
+    const char *include_patterns[MAX_CHANNEL_PATTERNS];
+    const char *exclude_patterns[MAX_CHANNEL_PATTERNS];
+    const char *stats_only_patterns[MAX_CHANNEL_PATTERNS];
+    int num_include = 0, num_exclude = 0, num_stats_only = 0;
+    int queue_capacity = 0;
+    const char *time_field = DEFAULT_TIME_FIELD;
+    time_field_rule_t time_field_rules[MAX_TIME_FIELD_RULES];
+    int num_time_field_rules = 0;
+    double gap_threshold = 0.0;
+    watch_t *watches[MAX_WATCHES];
+    int num_watches = 0;
+    int record_dump_only = 0; /* false */
+    int num_workers = 0;
+    int pin_workers = 1; /* true */
+    const char *urls[MAX_URLS];
+    int num_urls = 0;
+
+    static const struct option long_opts[] = {
+        { "url",      required_argument, NULL, 'u' },
+        { "stats",    no_argument,       NULL, 's' },
+        { "interval", required_argument, NULL, 'i' },
+        { "format",   required_argument, NULL, 'f' },
+        { "output",   required_argument, NULL, 'o' },
+        { "log",      required_argument, NULL, 'l' },
+        { "decode",   no_argument,       NULL, 'D' },
+        { "record",   required_argument, NULL, 'r' },
+        { "record-size",     required_argument, NULL, OPT_RECORD_SIZE },
+        { "record-channels", required_argument, NULL, OPT_RECORD_CHANNELS },
+        { "dump",     no_argument,       NULL, OPT_DUMP },
+        { "workers",  required_argument, NULL, 'w' },
+        { "no-pin",   no_argument,       NULL, OPT_NO_PIN },
+        { "include",  required_argument, NULL, OPT_INCLUDE },
+        { "exclude",  required_argument, NULL, OPT_EXCLUDE },
+        { "stats-only",     required_argument, NULL, OPT_STATS_ONLY },
+        { "queue-capacity", required_argument, NULL, OPT_QUEUE_CAPACITY },
+        { "time-field",     required_argument, NULL, OPT_TIME_FIELD },
+        { "gap",      required_argument, NULL, OPT_GAP },
+        { "watch",    required_argument, NULL, OPT_WATCH },
+        { "debug",    no_argument,       NULL, 'd' },
+        { "help",     no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
 
-    // XXX get opt
-    if(argc > 1 && strcmp(argv[1], "--debug") == 0)
-        is_debug_mode = 1;
+    int c;
+    while((c = getopt_long(argc, argv, "u:si:f:o:l:Dr:w:h", long_opts, NULL)) != -1) {
+        switch(c) {
+            case 'u':
+                if(num_urls == MAX_URLS) {
+                    fprintf(stderr, "ERR: at most %d urls are supported\n", MAX_URLS);
+                    return 1;
+                }
+                urls[num_urls++] = optarg;
+                break;
+            case 's':
+                is_headless = 1; /* true */
+                break;
+            case 'i': {
+                char *end;
+                stats_interval = strtod(optarg, &end);
+                if(*end != '\0' || !(stats_interval > 0)) {
+                    fprintf(stderr, "ERR: invalid interval '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+            case 'f':
+                if(stats_format_parse(optarg, &stats_format) != 0) {
+                    fprintf(stderr, "ERR: unknown stats format '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'o':
+                stats_filename = optarg;
+                break;
+            case 'l':
+                log_filename = optarg;
+                break;
+            case 'D':
+                log_decode = 1; /* true */
+                break;
+            case 'r':
+                record_filename = optarg;
+                break;
+            case OPT_RECORD_SIZE: {
+                char *end;
+                record_size = strtoull(optarg, &end, 10);
+                if(*end != '\0' || record_size == 0) {
+                    fprintf(stderr, "ERR: invalid record size '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+            case OPT_RECORD_CHANNELS:
+                record_channels = optarg;
+                break;
+            case OPT_DUMP:
+                record_dump_only = 1; /* true */
+                break;
+            case 'w': {
+                char *end;
+                num_workers = strtol(optarg, &end, 10);
+                if(*end != '\0' || num_workers < 0 || num_workers > MAX_WORKERS) {
+                    fprintf(stderr, "ERR: invalid number of workers '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+            case OPT_NO_PIN:
+                pin_workers = 0; /* false */
+                break;
+            case OPT_INCLUDE:
+            case OPT_EXCLUDE:
+            case OPT_STATS_ONLY: {
+                const char **patterns = (c == OPT_INCLUDE) ? include_patterns :
+                                        (c == OPT_EXCLUDE) ? exclude_patterns : stats_only_patterns;
+                int *n = (c == OPT_INCLUDE) ? &num_include :
+                         (c == OPT_EXCLUDE) ? &num_exclude : &num_stats_only;
+                if(*n == MAX_CHANNEL_PATTERNS) {
+                    fprintf(stderr, "ERR: too many channel patterns\n");
+                    return 1;
+                }
+                patterns[(*n)++] = optarg;
+                break;
+            }
+            case OPT_TIME_FIELD: {
+                char *eq = strchr(optarg, '=');
+                if(eq == NULL) {
+                    time_field = optarg;
+                    break;
+                }
+                if(num_time_field_rules == MAX_TIME_FIELD_RULES) {
+                    fprintf(stderr, "ERR: too many time fields\n");
+                    return 1;
+                }
+                *eq = '\0';
+                time_field_rules[num_time_field_rules].typename = optarg;
+                time_field_rules[num_time_field_rules].field = eq + 1;
+                num_time_field_rules++;
+                break;
+            }
+            case OPT_WATCH:
+                if(num_watches == MAX_WATCHES) {
+                    fprintf(stderr, "ERR: at most %d watches are supported\n", MAX_WATCHES);
+                    return 1;
+                }
+                watches[num_watches] = watch_create(optarg);
+                if(watches[num_watches] == NULL)
+                    return 1;
+                num_watches++;
+                break;
+            case OPT_GAP: {
+                char *end;
+                gap_threshold = strtod(optarg, &end);
+                if(*end != '\0' || !(gap_threshold > 0.0)) {
+                    fprintf(stderr, "ERR: invalid gap threshold '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+            case OPT_QUEUE_CAPACITY: {
+                char *end;
+                queue_capacity = strtol(optarg, &end, 10);
+                if(*end != '\0' || queue_capacity <= 0) {
+                    fprintf(stderr, "ERR: invalid queue capacity '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+            case 'd':
+                is_debug_mode = 1; /* true */
+                break;
+            case 'h':
+                usage(argv[0]);
+                return 0;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if(optind < argc) {
+        usage(argv[0]);
+        return 1;
+    }
+    // a log is a single source of messages
+    if(num_urls == 0 || log_filename != NULL) {
+        urls[0] = NULL;
+        num_urls = 1;
+    }
+
+    // the flight recorder, kept across runs (and crashes)
+    flight_rec_t *recorder = NULL;
+    if(record_filename != NULL) {
+        recorder = flight_rec_open(record_filename, record_size * 1024 * 1024);
+        if(recorder == NULL)
+            return 1;
+    }
+
+    if(record_dump_only) {
+        if(recorder == NULL) {
+            fprintf(stderr, "ERR: --dump requires --record\n");
+            return 1;
+        }
+        spyinfo_t spy = { .recorder = recorder, .record_filename = record_filename };
+        char filename[1024];
+        int64_t n = dump_recorder(&spy, filename, sizeof(filename));
+        if(n >= 0)
+            printf("Dumped %"PRId64" messages to %s\n", n, filename);
+        flight_rec_close(recorder);
+        return (n >= 0) ? 0 : 1;
+    }
+
+    GRegex *record_regex = NULL;
+    if(record_channels != NULL) {
+        GError *err = NULL;
+        record_regex = g_regex_new(record_channels, 0, 0, &err);
+        if(record_regex == NULL) {
+            fprintf(stderr, "ERR: invalid channel regex '%s': %s\n", record_channels, err->message);
+            g_error_free(err);
+            return 1;
+        }
+    }
+
+    int regex_err = 0; /* false */
+    char *include_pattern = join_channel_patterns(include_patterns, num_include);
+    char *exclude_pattern = join_channel_patterns(exclude_patterns, num_exclude);
+    char *stats_only_pattern = join_channel_patterns(stats_only_patterns, num_stats_only);
+    GRegex *include_regex = compile_channel_regex(include_pattern, "--include", &regex_err);
+    GRegex *exclude_regex = compile_channel_regex(exclude_pattern, "--exclude", &regex_err);
+    GRegex *stats_only_regex = compile_channel_regex(stats_only_pattern, "--stats-only", &regex_err);
+    free(exclude_pattern);
+    free(stats_only_pattern);
+    if(regex_err)
+        return 1;
 
     // get the lcmtypes .so from LCM_SPY_LITE_PATH
     const char *lcm_spy_lite_path = getenv("LCM_SPY_LITE_PATH");
@@ -624,29 +2531,75 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    // the type catalog cache, an empty LCM_SPY_LITE_CACHE disables it
+    char *cache_filename = NULL;
+    const char *cache_env = getenv("LCM_SPY_LITE_CACHE");
+    if(cache_env == NULL)
+        cache_filename = default_cache_filename();
+    else if(cache_env[0] != '\0')
+        cache_filename = strdup(cache_env);
+
+    // decoded messages go to per-channel arenas unless LCM_SPY_LITE_ARENA=0
+    const char *arena_env = getenv("LCM_SPY_LITE_ARENA");
+    int use_arena = (arena_env == NULL || strcmp(arena_env, "0") != 0);
+
     spyinfo_t spy = {
-        .names_array = g_array_new(TRUE, TRUE, sizeof(char *)),
-        .minfo_hashtbl = g_hash_table_new_full(g_str_hash, g_str_equal,
-                       (GDestroyNotify) free, (GDestroyNotify) msg_info_destroy),
-        .type_db = lcmtype_db_create(lcm_spy_lite_path, is_debug_mode),
+        .providers = calloc(num_urls, sizeof(provider_t)),
+        .num_providers = num_urls,
+        .type_db = lcmtype_db_create(lcm_spy_lite_path, cache_filename, is_debug_mode),
         .display_hz = 10,
+        .use_arena = use_arena,
+        .is_headless = is_headless || log_filename != NULL,
+        .stats_interval = stats_interval,
+        .stats_writer = NULL,
+        .recorder = recorder,
+        .record_filename = record_filename,
+        .record_regex = record_regex,
+        .include_pattern = include_pattern,
+        .include_regex = include_regex,
+        .exclude_regex = exclude_regex,
+        .stats_only_regex = stats_only_regex,
+        .queue_capacity = queue_capacity,
+        .time_field = time_field,
+        .gap_threshold = (uint64_t) (gap_threshold * 1000.0),
+        .watches = watches,
+        .num_watches = num_watches,
+        .num_time_field_rules = num_time_field_rules,
+        .num_dumps = 0,
+        .decode_all = 0,
+        .channels = g_ptr_array_new(),
+        .channels_gen = 0,
+        .is_dirty = 1,
+        .is_idle = 0,
+        .visible_channel = NULL,
         .mode = MODE_OVERVIEW,
         .is_selecting = 0,
         .decode_index = 0
     };
+    free(cache_filename);
 
     if(is_debug_mode)
         exit(0);
 
 
-    if (spy.names_array == NULL) {
+    if (spy.channels == NULL) {
         DEBUG(1, "ERR: failed to create array\n");
         exit(-1);
     }
 
-    if (spy.minfo_hashtbl == NULL) {
-        DEBUG(1, "ERR: failed to create hashtable\n");
-        exit(-1);
+    memcpy(spy.time_field_rules, time_field_rules, num_time_field_rules * sizeof(time_field_rule_t));
+
+    for(int p = 0; p < spy.num_providers; p++) {
+        provider_t *provider = &spy.providers[p];
+        provider->spy = &spy;
+        provider->index = p;
+        provider->url = urls[p];
+        provider->minfo_hashtbl = g_hash_table_new_full(g_str_hash, g_str_equal,
+                       (GDestroyNotify) free, (GDestroyNotify) msg_info_destroy);
+        if (provider->minfo_hashtbl == NULL) {
+            DEBUG(1, "ERR: failed to create hashtable\n");
+            exit(-1);
+        }
     }
 
     if (spy.type_db == NULL) {
@@ -654,39 +2607,133 @@ int main(int argc, char *argv[])
         exit(-1);
     }
 
+    if(is_headless) {
+        spy.stats_writer = stats_writer_create(stats_filename, stats_format);
+        if(spy.stats_writer == NULL)
+            exit(-1);
+    }
+
     signal(SIGINT, sighandler);
     signal(SIGQUIT, sighandler);
     signal(SIGTERM, sighandler);
+    signal(SIGUSR1, sighandler);
+    signal(SIGWINCH, sighandler);
+
+    // each url gets its own workers, on their own cores
+    if(num_workers > 0) {
+        for(int p = 0; p < spy.num_providers; p++) {
+            int first_core = pin_workers ? 1 + p * num_workers : -1;
+            spy.providers[p].pool = work_pool_create(num_workers, WORKER_QUEUE_SIZE, first_core,
+                                                     handle_msg, &spy);
+            if(spy.providers[p].pool == NULL)
+                exit(-1);
+        }
+    }
 
-    // configure stdout buffering: use FULL buffering to avoid flickering
-    setvbuf(stdout, NULL, _IOFBF, 2048);
+    // offline: this thread replays the log, no other threads are needed
+    if(log_filename != NULL) {
+        pthread_mutex_init(&spy.channels_mutex, NULL);
+        int ret = analyze_log(&spy, log_filename, log_decode);
+        work_pool_destroy(spy.providers[0].pool);
+        stats_writer_destroy(spy.stats_writer);
+        flight_rec_close(spy.recorder);
+        free_channel_filters(&spy);
+        pthread_mutex_destroy(&spy.channels_mutex);
+        for(int i = 0; i < spy.num_watches; i++)
+            watch_destroy(spy.watches[i]);
+        lcmtype_db_destroy(spy.type_db);
+        g_ptr_array_free(spy.channels, TRUE);
+        g_hash_table_destroy(spy.providers[0].minfo_hashtbl);
+        free(spy.providers);
+        return ret;
+    }
 
     // start threads
-    pthread_mutex_init(&spy.mutex, NULL);
+    pthread_mutex_init(&spy.channels_mutex, NULL);
+    pthread_mutex_init(&spy.ui_mutex, NULL);
+    pthread_mutex_init(&spy.recorder_mutex, NULL);
 
-    pthread_t print_thread;
-    if (pthread_create(&print_thread, NULL, (void *) print_thread_func, &spy)) {
-        printf("ERR: %s: Failed to start thread\n", "print_thread");
-        exit(-1);
-    }
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&spy.redraw_cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
 
+    pthread_t print_thread;
     pthread_t keyboard_thread;
-    if (pthread_create(&keyboard_thread, NULL, (void *) keyboard_thread_func, &spy)) {
-        printf("ERR: %s: Failed to start thread\n", "keyboard_thread");
-        exit(-1);
+    pthread_t stats_thread;
+    pthread_t dump_thread;
+    if(is_headless) {
+        if (pthread_create(&stats_thread, NULL, (void *) stats_thread_func, &spy)) {
+            printf("ERR: %s: Failed to start thread\n", "stats_thread");
+            exit(-1);
+        }
+    } else {
+        if (pthread_create(&print_thread, NULL, (void *) print_thread_func, &spy)) {
+            printf("ERR: %s: Failed to start thread\n", "print_thread");
+            exit(-1);
+        }
+
+        if (pthread_create(&keyboard_thread, NULL, (void *) keyboard_thread_func, &spy)) {
+            printf("ERR: %s: Failed to start thread\n", "keyboard_thread");
+            exit(-1);
+        }
     }
 
-    // use this thread as the lcm thread
-    lcm_thread_func(&spy);
+    if(spy.recorder != NULL) {
+        if (pthread_create(&dump_thread, NULL, (void *) dump_thread_func, &spy)) {
+            printf("ERR: %s: Failed to start thread\n", "dump_thread");
+            exit(-1);
+        }
+    }
 
+    // one lcm thread per url, this thread is the first one
+    for(int p = 1; p < spy.num_providers; p++) {
+        if (pthread_create(&spy.providers[p].thread, NULL, (void *) lcm_thread_func, &spy.providers[p])) {
+            printf("ERR: %s: Failed to start thread\n", "lcm_thread");
+            exit(-1);
+        }
+    }
+    lcm_thread_func(&spy.providers[0]);
+    for(int p = 1; p < spy.num_providers; p++)
+        pthread_join(spy.providers[p].thread, NULL);
 
     // cleanup
-    pthread_join(keyboard_thread, NULL);
-    pthread_join(print_thread, NULL);
-    pthread_mutex_destroy(&spy.mutex);
+    if(is_headless) {
+        pthread_join(stats_thread, NULL);
+        stats_writer_destroy(spy.stats_writer);
+    } else {
+        pthread_join(keyboard_thread, NULL);
+        pthread_join(print_thread, NULL);
+    }
+
+    // the screens show the worker pools, the recorder and the filters:
+    // tear them down once they are gone
+    for(int p = 0; p < spy.num_providers; p++) {
+        provider_t *provider = &spy.providers[p];
+        if(provider->pool != NULL) {
+            DEBUG(1, "INFO: the lcm thread of %s waited %"PRIu64" times for a full worker queue\n",
+                  provider_name(provider), work_pool_num_stalls(provider->pool));
+            work_pool_destroy(provider->pool);
+            provider->pool = NULL;
+        }
+    }
+
+    if(spy.recorder != NULL)
+        pthread_join(dump_thread, NULL);
+    flight_rec_close(spy.recorder);
+    free_channel_filters(&spy);
+    pthread_mutex_destroy(&spy.channels_mutex);
+    pthread_mutex_destroy(&spy.ui_mutex);
+    pthread_mutex_destroy(&spy.recorder_mutex);
+    pthread_cond_destroy(&spy.redraw_cond);
     lcmtype_db_destroy(spy.type_db);
-    g_array_free(spy.names_array, TRUE);
-    g_hash_table_destroy(spy.minfo_hashtbl);
+    g_ptr_array_free(spy.channels, TRUE);
+    for(int p = 0; p < spy.num_providers; p++)
+        g_hash_table_destroy(spy.providers[p].minfo_hashtbl);
+    free(spy.providers);
+    for(int i = 0; i < spy.num_watches; i++)
+        watch_destroy(spy.watches[i]);
 
     DEBUG(1, "Exiting...\n");
     return 0;
@@ -0,0 +1,292 @@
+#include "msg_decode.h"
+
+#include <string.h>
+
+/* the lcm wire format is big-endian and has no padding:
+     - the top-level message starts with its 64-bit hash
+     - fields follow in declaration order, nested types without a hash
+     - arrays are flattened in row-major order
+     - a string is an int32 length (including the '\0') and the bytes
+   The C struct stores fixed-size arrays inline; as soon as one dimension
+   is variable, every dimension is a malloc'ed array of pointers instead.
+
+   Lengths come from the wire, so they are checked against the remaining
+   data before anything is allocated for them. The decoded message also
+   never takes more than DECODE_MAX_EXPANSION times its encoded size (plus
+   DECODE_MIN_BUDGET): a corrupt or hostile length fails the decode
+   instead of allocating gigabytes.
+*/
+
+#define DECODE_MAX_EXPANSION 64
+#define DECODE_MIN_BUDGET (1 << 20)
+
+typedef struct
+{
+    const uint8_t *buf;
+    size_t size;
+    size_t pos;
+
+    lcmtype_db_t *db;
+    arena_t *arena;
+    uint64_t num_allocs;
+    size_t budget;  // bytes the arena may still hand out
+
+} decoder_t;
+
+static inline int has_bytes(const decoder_t *d, size_t n)
+{
+    return n <= d->size - d->pos;
+}
+
+static inline uint16_t read_be16(const uint8_t *p)
+{
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return __builtin_bswap16(v);
+}
+
+static inline uint32_t read_be32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return __builtin_bswap32(v);
+}
+
+static inline uint64_t read_be64(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return __builtin_bswap64(v);
+}
+
+// returns 'n' values of 'eltsz' bytes, or NULL past the budget or out of memory
+static inline void *decoder_alloc(decoder_t *d, size_t n, size_t eltsz)
+{
+    size_t size;
+    if(__builtin_mul_overflow(n, eltsz, &size) || size > d->budget)
+        return NULL;
+    d->budget -= size;
+    d->num_allocs++;
+    return arena_alloc(d->arena, size);
+}
+
+static int decode_strings(decoder_t *d, char **dst, int32_t n)
+{
+    for(int32_t i = 0; i < n; i++) {
+        if(!has_bytes(d, 4))
+            return -1;
+        int32_t len = (int32_t) read_be32(d->buf + d->pos);
+        d->pos += 4;
+        if(len <= 0 || !has_bytes(d, len))
+            return -1;
+
+        char *s = decoder_alloc(d, len, 1);
+        if(s == NULL)
+            return -1;
+        memcpy(s, d->buf + d->pos, len);
+        s[len-1] = '\0';
+        dst[i] = s;
+        d->pos += len;
+    }
+    return 0;
+}
+
+static int decode_primitives(decoder_t *d, lcm_field_type_t type, void *dst, int32_t n)
+{
+    if(type == LCM_FIELD_STRING)
+        return decode_strings(d, dst, n);
+
+    size_t eltsz;
+    switch(type) {
+        case LCM_FIELD_INT8_T:
+        case LCM_FIELD_BYTE:
+        case LCM_FIELD_BOOLEAN:  eltsz = 1; break;
+        case LCM_FIELD_INT16_T:  eltsz = 2; break;
+        case LCM_FIELD_INT32_T:
+        case LCM_FIELD_FLOAT:    eltsz = 4; break;
+        case LCM_FIELD_INT64_T:
+        case LCM_FIELD_DOUBLE:   eltsz = 8; break;
+        default:                 return -1;
+    }
+
+    size_t total = eltsz * n;
+    if(!has_bytes(d, total))
+        return -1;
+
+    const uint8_t *src = d->buf + d->pos;
+    d->pos += total;
+
+    switch(eltsz) {
+        case 1:
+            memcpy(dst, src, n);
+            break;
+        case 2:
+            for(int32_t i = 0; i < n; i++)
+                ((uint16_t *) dst)[i] = read_be16(src + 2*i);
+            break;
+        case 4:
+            for(int32_t i = 0; i < n; i++)
+                ((uint32_t *) dst)[i] = read_be32(src + 4*i);
+            break;
+        case 8:
+            for(int32_t i = 0; i < n; i++)
+                ((uint64_t *) dst)[i] = read_be64(src + 8*i);
+            break;
+    }
+    return 0;
+}
+
+static int decode_struct(decoder_t *d, const lcmtype_metadata_t *metadata, void *msg);
+
+// decodes 'n' consecutive values of the field's element type
+static int decode_values(decoder_t *d, const lcmtype_field_t *field, void *dst, int32_t n)
+{
+    if(field->type != LCM_FIELD_USER_TYPE)
+        return decode_primitives(d, field->type, dst, n);
+
+    if(field->usertype == NULL)
+        return -1;
+    for(int32_t i = 0; i < n; i++)
+        if(decode_struct(d, field->usertype, (uint8_t *) dst + i * field->elt_size) != 0)
+            return -1;
+    return 0;
+}
+
+// the smallest encoded size of one value of the field
+static size_t min_wire_elt_size(decoder_t *d, const lcmtype_field_t *field)
+{
+    switch(field->type) {
+        case LCM_FIELD_INT8_T:
+        case LCM_FIELD_BYTE:
+        case LCM_FIELD_BOOLEAN:  return 1;
+        case LCM_FIELD_INT16_T:  return 2;
+        case LCM_FIELD_INT32_T:
+        case LCM_FIELD_FLOAT:    return 4;
+        case LCM_FIELD_INT64_T:
+        case LCM_FIELD_DOUBLE:   return 8;
+        case LCM_FIELD_STRING:   return 5;  // the length and the '\0'
+        case LCM_FIELD_USER_TYPE: {
+            // a variable-size type still takes at least a byte
+            int64_t size = lcmtype_db_wire_elt_size(d->db, field);
+            return (size >= 0) ? (size_t) size : 1;
+        }
+        default:                 return 1;
+    }
+}
+
+// can the remaining data hold every value of a variable-size array ?
+static int has_array_bytes(decoder_t *d, const lcmtype_fields_t *fields, const lcmtype_field_t *field,
+                           const void *msg)
+{
+    size_t remaining = d->size - d->pos;
+    size_t eltsz = min_wire_elt_size(d, field);
+    size_t n = 1;
+    for(int dim = 0; dim < field->num_dim; dim++) {
+        int32_t len = lcmtype_fields_dim_size(fields, field, msg, dim);
+        if(len < 0)
+            return 0; /* false */
+        if(len == 0)
+            return 1; /* true */
+        if(__builtin_mul_overflow(n, (size_t) len, &n))
+            return 0; /* false */
+    }
+
+    size_t total;
+    return !__builtin_mul_overflow(n, eltsz, &total) && total <= remaining;
+}
+
+// decodes dimension 'dim' (and the inner ones) of an array with pointer levels
+static int decode_array_level(decoder_t *d, const lcmtype_fields_t *fields, const lcmtype_field_t *field,
+                              const void *msg, void **dst, int dim)
+{
+    if(dim == 0 && !has_array_bytes(d, fields, field, msg))
+        return -1;
+
+    int32_t n = lcmtype_fields_dim_size(fields, field, msg, dim);
+    if(n < 0)
+        return -1;
+    if(n == 0) {
+        *dst = NULL;
+        return 0;
+    }
+
+    if(dim == field->num_dim - 1) {
+        *dst = decoder_alloc(d, n, field->elt_size);
+        if(*dst == NULL)
+            return -1;
+        return decode_values(d, field, *dst, n);
+    }
+
+    void **ptrs = decoder_alloc(d, n, sizeof(void *));
+    *dst = ptrs;
+    if(ptrs == NULL)
+        return -1;
+    for(int32_t i = 0; i < n; i++)
+        if(decode_array_level(d, fields, field, msg, &ptrs[i], dim+1) != 0)
+            return -1;
+    return 0;
+}
+
+static int decode_struct(decoder_t *d, const lcmtype_metadata_t *metadata, void *msg)
+{
+    const lcmtype_fields_t *fields = lcmtype_db_get_fields(d->db, metadata);
+
+    for(int i = 0; i < fields->num_fields; i++) {
+        const lcmtype_field_t *field = &fields->fields[i];
+        void *data = (uint8_t *) msg + field->offset;
+        int ret;
+
+        if(field->num_dim == 0) {
+            ret = decode_values(d, field, data, 1);
+        } else if(!field->has_variable_dim) {
+            // fixed-size arrays are stored inline, in wire order
+            int32_t n = 1;
+            for(int dim = 0; dim < field->num_dim; dim++)
+                n *= field->dim_size[dim];
+            ret = decode_values(d, field, data, n);
+        } else {
+            ret = decode_array_level(d, fields, field, msg, (void **) data, 0);
+        }
+
+        if(ret != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+void *msg_decode(lcmtype_db_t *db, const lcmtype_metadata_t *metadata,
+                 const void *buf, size_t size, arena_t *arena, uint64_t *num_allocs)
+{
+    decoder_t d = {
+        .buf = buf,
+        .size = size,
+        .pos = 0,
+        .db = db,
+        .arena = arena,
+        .num_allocs = 0,
+        .budget = (size < (SIZE_MAX - DECODE_MIN_BUDGET) / DECODE_MAX_EXPANSION) ?
+                  size * DECODE_MAX_EXPANSION + DECODE_MIN_BUDGET : SIZE_MAX
+    };
+
+    if(size < 8 || (int64_t) read_be64(d.buf) != metadata->hash)
+        return NULL;
+    d.pos = 8;
+
+    size_t struct_size = metadata->typeinfo->struct_size();
+    void *msg = arena_alloc(arena, struct_size);
+    if(msg == NULL)
+        return NULL;
+    memset(msg, 0, struct_size);
+
+    if(decode_struct(&d, metadata, msg) != 0)
+        return NULL;
+
+    *num_allocs = d.num_allocs;
+    return msg;
+}
+
+int msg_decode_is_supported(lcmtype_db_t *db, const lcmtype_metadata_t *metadata)
+{
+    return lcmtype_db_is_resolved(db, metadata);
+}
@@ -0,0 +1,33 @@
+#ifndef MSG_DECODE_H
+#define MSG_DECODE_H
+
+#include "lcmtype_db.h"
+#include "arena.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* decodes an encoded lcm message (starting with its hash) using the field
+   descriptors of 'metadata'. The message struct and everything it points
+   to are allocated from 'arena': nothing needs to be cleaned up besides
+   resetting the arena. The result is laid out exactly like the one from
+   the generated decode(), but it must NOT be passed to decode_cleanup().
+
+   Returns NULL if the data is invalid (lengths the data can't hold
+   included) or a nested type is unknown, see msg_decode_is_supported()
+   to tell them apart.
+   '*num_allocs' is set to the number of allocations served by the arena.
+*/
+void *msg_decode(lcmtype_db_t *db, const lcmtype_metadata_t *metadata,
+                 const void *buf, size_t size, arena_t *arena, uint64_t *num_allocs);
+
+/* non-zero if every nested type of 'metadata' is known: msg_decode() then
+   only fails on invalid data, which the generated decoder would reject too */
+int msg_decode_is_supported(lcmtype_db_t *db, const lcmtype_metadata_t *metadata);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* MSG_DECODE_H */
@@ -1,19 +1,47 @@
 #include "msg_display.h"
+#include "strbuf.h"
 
 #include <stdio.h>
+#include <string.h>
 #include <inttypes.h>
 #include <assert.h>
 #include <stdarg.h>
+#include <math.h>
 
-#define LINE_FMT_STR "    %-20.20s %-20.20s "
-#define MAX_ARRAY_DISPLAY 100
+#define LINE_NAME_WIDTH 20
 #define MAX_ARRAY_ELT_PER_LINE 10
 
+// the "    <name> <type> " start of each field line
+static inline void append_line_prefix(strbuf_t *out, const char *name, const char *typestr)
+{
+    strbuf_append(out, "    ", 4);
+    strbuf_append_column(out, name, LINE_NAME_WIDTH);
+    strbuf_append_char(out, ' ');
+    strbuf_append_column(out, typestr, LINE_NAME_WIDTH);
+    strbuf_append_char(out, ' ');
+}
+
 static inline int is_ascii(int8_t c)
 {
     return (32 <= c && c <= 126);
 }
-static void print_value_scalar(lcmtype_db_t *db, lcm_field_t *field, void *data, int *usertype_count)
+// like printf("% d"): a space in place of the '+' sign
+static inline void append_signed(strbuf_t *out, int64_t v)
+{
+    if(v >= 0)
+        strbuf_append_char(out, ' ');
+    strbuf_append_i64(out, v);
+}
+
+static inline void append_float(strbuf_t *out, double v)
+{
+    if(!signbit(v))
+        strbuf_append_char(out, ' ');
+    strbuf_append_double(out, v, 6);
+}
+
+// 'usertype_id' is the number a nested message is selected with
+static void print_value_scalar(strbuf_t *out, const lcmtype_field_t *field, void *data, int64_t usertype_id)
 {
 
     switch(field->type) {
@@ -21,105 +49,209 @@ static void print_value_scalar(lcmtype_db_t *db, lcm_field_t *field, void *data,
         case LCM_FIELD_BYTE:
         case LCM_FIELD_INT8_T: {
             int8_t i = *(int8_t *) data;
-            printf(" %d", i);
-            if(is_ascii(i))
-                printf(" (%c)", i);
+            strbuf_append_char(out, ' ');
+            strbuf_append_i64(out, i);
+            if(is_ascii(i)) {
+                strbuf_append(out, " (", 2);
+                strbuf_append_char(out, i);
+                strbuf_append_char(out, ')');
+            }
             break;
         }
 
         case LCM_FIELD_INT16_T:
-            printf("% d", *(int16_t *) data);
+            append_signed(out, *(int16_t *) data);
             break;
 
         case LCM_FIELD_INT32_T:
-            printf("% d", *(int32_t *) data);
+            append_signed(out, *(int32_t *) data);
             break;
 
         case LCM_FIELD_INT64_T:
-            printf("% " PRIi64 "", *(int64_t *) data);
+            append_signed(out, *(int64_t *) data);
             break;
 
         case LCM_FIELD_FLOAT:
-            printf("% f", *(float *) data);
+            append_float(out, *(float *) data);
             break;
 
         case LCM_FIELD_DOUBLE:
-            printf("% f", *(double *) data);
+            append_float(out, *(double *) data);
             break;
 
         case LCM_FIELD_STRING:
-            printf("\"%s\"", *(const char **) data);
+            strbuf_append_char(out, '"');
+            if(*(const char **) data != NULL)
+                strbuf_append_str(out, *(const char **) data);
+            strbuf_append_char(out, '"');
             break;
 
         case LCM_FIELD_BOOLEAN:
-            printf("%s", (*(int8_t*) data) == 1 ? "true" : "false");
+            strbuf_append_str(out, (*(int8_t*) data) == 1 ? "true" : "false");
             break;
 
         case LCM_FIELD_USER_TYPE: {
-            const lcmtype_metadata_t *md = lcmtype_db_get_using_name(db, field->typestr);
-            if(md == NULL) {
-                printf("<unknown-user-type>");
+            if(field->usertype == NULL) {
+                strbuf_append_str(out, "<unknown-user-type>");
             } else {
-                if(usertype_count == NULL) {
-                    printf("<USER>");
-                } else {
-                    int n = ++*usertype_count;
-                    printf("<%d>", n);
-                }
+                strbuf_append_char(out, '<');
+                strbuf_append_i64(out, usertype_id);
+                strbuf_append_char(out, '>');
             }
             break;
         }
 
         default:
-            printf("???");
+            strbuf_append_str(out, "???");
             fprintf(stderr, "ERR: failed to handle lcm message field type: %s\n", field->typestr);
             break;
     }
 }
 
-static size_t typesize(lcm_field_type_t type)
+/* an array is displayed row by row, a row being the innermost dimension:
+   MAX_ARRAY_ELT_PER_LINE values per line, and for multi-dimensional arrays
+   a first line with the dimensions and the index of each row.
+   The number of lines only depends on the dimensions, so the lines before
+   the viewport are skipped without looking at the values */
+typedef struct
 {
-    switch(type) {
-        case LCM_FIELD_INT8_T:   return sizeof(int8_t);
-        case LCM_FIELD_INT16_T:  return sizeof(int16_t);
-        case LCM_FIELD_INT32_T:  return sizeof(int32_t);
-        case LCM_FIELD_INT64_T:  return sizeof(int64_t);
-        case LCM_FIELD_BYTE:     return sizeof(int8_t);
-        case LCM_FIELD_FLOAT:    return sizeof(float);
-        case LCM_FIELD_DOUBLE:   return sizeof(double);
-        case LCM_FIELD_STRING:   return sizeof(const char *);
-        case LCM_FIELD_BOOLEAN:  return sizeof(int8_t);
+    int num_dim;
+    int32_t dims[LCM_TYPE_FIELD_MAX_DIM];
+    int64_t num_rows;
+    int32_t row_len;
+    int64_t lines_per_row;
+    int64_t num_lines;
+    int label_width;  /* of the "[i][j]" row indices */
 
-        case LCM_FIELD_USER_TYPE:
-        default:
-            return 0;
+} array_layout_t;
+
+static inline int num_digits(int64_t v)
+{
+    int n = 1;
+    while(v >= 10) {
+        v /= 10;
+        n++;
     }
+    return n;
 }
 
-static void print_value_array(lcmtype_db_t *db, lcm_field_t *field, void *data, int *usertype_count)
+static void array_layout(array_layout_t *this, const lcmtype_fields_t *fields,
+                         const lcmtype_field_t *field, const void *msg)
 {
-    if(field->num_dim == 1) {
-        printf("[");
-        int len = field->dim_size[0];
-        size_t elt_size = typesize(field->type);
-        void *p = (!field->dim_is_variable[0]) ? field->data : *(void **) field->data;
-        for(int i = 0; i < len; i++) {
-            if(i != 0 && i % MAX_ARRAY_ELT_PER_LINE == 0) {
-                printf("\n" LINE_FMT_STR " ", "", "");
-            }
-            if(i == MAX_ARRAY_DISPLAY) {
-                printf("...more...");
-                break;
+    this->num_dim = field->num_dim;
+    this->num_rows = 1;
+    this->label_width = 0;
+    for(int d = 0; d < field->num_dim; d++) {
+        int32_t n = lcmtype_fields_dim_size(fields, field, msg, d);
+        this->dims[d] = (n > 0) ? n : 0;
+        if(d < field->num_dim - 1) {
+            this->num_rows *= this->dims[d];
+            this->label_width += 2 + num_digits(this->dims[d] > 0 ? this->dims[d] - 1 : 0);
+        }
+    }
+    this->row_len = this->dims[field->num_dim - 1];
+    this->lines_per_row = (this->row_len + MAX_ARRAY_ELT_PER_LINE - 1) / MAX_ARRAY_ELT_PER_LINE;
+    if(this->lines_per_row == 0)
+        this->lines_per_row = 1;
+
+    if(this->num_dim == 1)
+        this->num_lines = this->lines_per_row;
+    else
+        this->num_lines = 1 + this->num_rows * this->lines_per_row;
+}
+
+// the indices of a row in the outer dimensions (row-major)
+static inline void row_indices(const array_layout_t *this, int64_t row, int32_t *index)
+{
+    for(int d = this->num_dim - 2; d >= 0; d--) {
+        index[d] = row % this->dims[d];
+        row /= this->dims[d];
+    }
+}
+
+/* the first value of a row. Fixed-size arrays are stored inline, as soon as
+   one dimension is variable every dimension is an array of pointers instead */
+static void *array_row(const array_layout_t *this, const lcmtype_field_t *field, void *data, int64_t row)
+{
+    if(!field->has_variable_dim)
+        return (uint8_t *) data + row * this->row_len * field->elt_size;
+
+    int32_t index[LCM_TYPE_FIELD_MAX_DIM];
+    row_indices(this, row, index);
+
+    void *p = *(void **) data;
+    for(int d = 0; d < this->num_dim - 1 && p != NULL; d++)
+        p = ((void **) p)[index[d]];
+    return p;
+}
+
+static void append_row_label(strbuf_t *out, const array_layout_t *this, int64_t row)
+{
+    int32_t index[LCM_TYPE_FIELD_MAX_DIM];
+    row_indices(this, row, index);
+
+    size_t start = out->len;
+    for(int d = 0; d < this->num_dim - 1; d++) {
+        strbuf_append_char(out, '[');
+        strbuf_append_i64(out, index[d]);
+        strbuf_append_char(out, ']');
+    }
+    strbuf_ljust(out, start, this->label_width);
+}
+
+// line 'line' of an array field, 'usertype_id' is the one of its first value
+static void print_array_line(strbuf_t *out, const lcmtype_field_t *field, const array_layout_t *layout,
+                             void *data, int64_t line, int64_t usertype_id)
+{
+    if(layout->num_dim > 1) {
+        if(line == 0) {
+            append_line_prefix(out, field->name, field->typestr);
+            for(int d = 0; d < layout->num_dim; d++) {
+                strbuf_append_char(out, '[');
+                strbuf_append_i64(out, layout->dims[d]);
+                strbuf_append_char(out, ']');
             }
-            print_value_scalar(db, field, p, usertype_count);
-            if(i+1 != len)
-                printf(", ");
-            p = (void *)((uint8_t *) p + elt_size);
+            return;
         }
-        printf(" ]");
+        line--;
+    }
+
+    int64_t row = line / layout->lines_per_row;
+    int64_t part = line % layout->lines_per_row;
+    int is_first = (part == 0);
+    int is_last = (part == layout->lines_per_row - 1);
+
+    if(layout->num_dim == 1 && is_first) {
+        append_line_prefix(out, field->name, field->typestr);
     } else {
-        printf("<Multi-dim array: not yet supported>");
+        append_line_prefix(out, "", "");
+        if(layout->num_dim > 1) {
+            if(is_first)
+                append_row_label(out, layout, row);
+            else
+                strbuf_append_column(out, "", layout->label_width);
+            strbuf_append_char(out, ' ');
+        }
+    }
+    strbuf_append_char(out, is_first ? '[' : ' ');
+
+    int32_t begin = part * MAX_ARRAY_ELT_PER_LINE;
+    int32_t end = begin + MAX_ARRAY_ELT_PER_LINE;
+    if(end > layout->row_len)
+        end = layout->row_len;
+
+    uint8_t *p = array_row(layout, field, data, row);
+    if(p != NULL) {
+        usertype_id += row * layout->row_len;
+        for(int32_t i = begin; i < end; i++) {
+            print_value_scalar(out, field, p + i * field->elt_size, usertype_id + i);
+            if(i+1 != layout->row_len)
+                strbuf_append(out, ", ", 2);
+        }
     }
+
+    if(is_last)
+        strbuf_append(out, " ]", 2);
 }
 
 static inline void strnfmtappend(char *buf, size_t sz, size_t *used, const char *fmt, ...)
@@ -136,17 +268,17 @@ static inline void strnfmtappend(char *buf, size_t sz, size_t *used, const char
         *used = sz;
 }
 
-void msg_display(lcmtype_db_t *db, const lcmtype_metadata_t *metadata, void *msg, const msg_display_state_t *state)
+/* walk the recur_table down from the top message, filling in cache->traversal
+   returns the sub-message, or NULL after appending an error to 'out'
+   '*is_static' is cleared when the path depends on variable array lengths */
+static void *resolve_submsg(strbuf_t *out, lcmtype_db_t *db, const lcmtype_metadata_t **metadata,
+                            void *msg, const msg_display_state_t *state,
+                            msg_display_cache_t *cache, int *is_static)
 {
-    assert(state != NULL);
-
-    /* first, we need to resolve/recurse to the proper submessage */
-    #define TRAVERSAL_BUFSZ 1024
-    char traversal[TRAVERSAL_BUFSZ];
     size_t traversal_used = 0;
-
-    strnfmtappend(traversal, TRAVERSAL_BUFSZ, &traversal_used,
+    strnfmtappend(cache->traversal, MSG_DISPLAY_TRAVERSAL_BUFSZ, &traversal_used,
                   "top");
+    *is_static = 1; /* true */
 
     size_t i;
     for(i = 0; i < state->cur_depth; i++) {
@@ -155,97 +287,163 @@ void msg_display(lcmtype_db_t *db, const lcmtype_metadata_t *metadata, void *msg
         size_t recur_i = state->recur_table[i];
 
         // iterate through the fields until we find the corresponding one
-        lcm_field_t field;
-        const lcm_type_info_t *typeinfo = metadata->typeinfo;
-        int num_fields = typeinfo->num_fields();
+        // scalars count for one nested message, arrays for all their values
+        const lcmtype_fields_t *fields = lcmtype_db_get_fields(db, *metadata);
+        const lcmtype_field_t *field = NULL;
+        array_layout_t layout;
         size_t user_field_count = 0;
-        int inside_array;
-        int index;
-        for(int j = 0; j < num_fields; j++) {
-            typeinfo->get_field(msg, j, &field);
-            inside_array = 0;
-
-            if(field.type == LCM_FIELD_USER_TYPE) {
-
-                // two possiblities here: 1) scalar or 2) array
-
-                // 1) its a scalar
-                if(field.num_dim == 0)  {
-                    if(++user_field_count == recur_i)
-                        break;
-                }
-
-                // 2) its an array
-                else if(field.num_dim == 1) {
-                    inside_array = 1;
-                    for(index = 0; index < field.dim_size[0]; index++) {
-                        if(++user_field_count == recur_i)
-                            goto break_loop;
-                    }
-                }
-
-                else {
-                    //DEBUG(1, "NOTE: Multi-dim arrays not supported\n");
-                }
+        int64_t index = -1;
+        for(int j = 0; j < fields->num_fields; j++) {
+            field = &fields->fields[j];
+            if(field->type != LCM_FIELD_USER_TYPE)
+                continue;
+
+            if(field->num_dim == 0) {
+                if(++user_field_count == recur_i)
+                    break;
+                continue;
             }
+
+            if(field->has_variable_dim)
+                *is_static = 0; /* false */
+            array_layout(&layout, fields, field, msg);
+            size_t len = layout.num_rows * layout.row_len;
+            if(recur_i > user_field_count && recur_i - user_field_count <= len) {
+                index = recur_i - user_field_count - 1;
+                user_field_count = recur_i;
+                break;
+            }
+            user_field_count += len;
         }
 
-    break_loop:
         // not found?
-        if(user_field_count != recur_i)
+        if(recur_i == 0 || user_field_count != recur_i)
             break;
 
-        msg = field.data;
-        metadata = lcmtype_db_get_using_name(db, field.typestr);
-        if(metadata == NULL) {
-            printf("ERROR: failed to find %s\n", field.typestr);
-            return;
+        if(field->usertype == NULL) {
+            strbuf_printf(out, "ERROR: failed to find %s\n", field->typestr);
+            return NULL;
         }
+        *metadata = field->usertype;
+        msg = (uint8_t *) msg + field->offset;
 
-        strnfmtappend(traversal, TRAVERSAL_BUFSZ, &traversal_used,
-                      " -> %s", field.name);
-
-        if(inside_array) {
+        strnfmtappend(cache->traversal, MSG_DISPLAY_TRAVERSAL_BUFSZ, &traversal_used,
+                      " -> %s", field->name);
 
-            // if its a variable array, we need to dereference the field
-            // to get the actual array address
-            if(field.dim_is_variable[0])
-                msg = *(void **)msg;
-
-            // compute the address of this index
-            size_t typesz = metadata->typeinfo->struct_size();
-            msg += typesz * index;
-
-            strnfmtappend(traversal, TRAVERSAL_BUFSZ, &traversal_used,
-                          "[%d]", index);
+        if(index >= 0) {
+            int64_t row = index / layout.row_len;
+            int32_t col = index % layout.row_len;
+            msg = array_row(&layout, field, msg, row);
+            if(msg == NULL)
+                break;
+            msg = (uint8_t *) msg + col * field->elt_size;
+
+            int32_t indices[LCM_TYPE_FIELD_MAX_DIM];
+            row_indices(&layout, row, indices);
+            indices[layout.num_dim - 1] = col;
+            for(int d = 0; d < layout.num_dim; d++)
+                strnfmtappend(cache->traversal, MSG_DISPLAY_TRAVERSAL_BUFSZ, &traversal_used,
+                              "[%d]", indices[d]);
         }
 
     }
 
     // sub-message recurse failed?
     if(i != state->cur_depth) {
-        printf("ERROR: failed recurse to find sub-messages\n");
-        return;
+        strbuf_printf(out, "ERROR: failed recurse to find sub-messages\n");
+        return NULL;
+    }
+
+    return msg;
+}
+
+static inline int cache_matches(const msg_display_cache_t *cache, const lcmtype_metadata_t *metadata,
+                                const msg_display_state_t *state)
+{
+    return cache->is_valid &&
+           cache->metadata == metadata &&
+           cache->cur_depth == state->cur_depth &&
+           memcmp(cache->recur_table, state->recur_table, state->cur_depth * sizeof(size_t)) == 0;
+}
+
+size_t msg_display(strbuf_t *out, lcmtype_db_t *db, const lcmtype_metadata_t *metadata, void *msg,
+                   const msg_display_state_t *state, msg_display_cache_t *cache,
+                   const msg_display_viewport_t *viewport)
+{
+    assert(state != NULL);
+
+    msg_display_cache_t scratch;
+    if(cache == NULL) {
+        scratch.is_valid = 0; /* false */
+        cache = &scratch;
     }
 
-    const lcm_type_info_t *typeinfo = metadata->typeinfo;
-    lcm_field_t field;
-    int num_fields = typeinfo->num_fields();
-    int usertype_count = 0;
+    /* first, we need to resolve/recurse to the proper submessage
+       unless the path was already resolved for this state */
+    if(cache_matches(cache, metadata, state)) {
+        msg = (uint8_t *) msg + cache->sub_offset;
+        metadata = cache->sub_metadata;
+    } else {
+        const lcmtype_metadata_t *top_metadata = metadata;
+        void *top = msg;
+        int is_static;
+        cache->is_valid = 0; /* false */
+        msg = resolve_submsg(out, db, &metadata, msg, state, cache, &is_static);
+        if(msg == NULL)
+            return 0;
 
-    printf("         Traversal: %s \n", traversal);
-    printf("   ----------------------------------------------------------------\n");
+        // a path that only crossed fixed-size fields is valid for any message
+        if(is_static) {
+            cache->is_valid = 1; /* true */
+            cache->metadata = top_metadata;
+            cache->cur_depth = state->cur_depth;
+            memcpy(cache->recur_table, state->recur_table, state->cur_depth * sizeof(size_t));
+            cache->sub_metadata = metadata;
+            cache->sub_offset = (uint8_t *) msg - (uint8_t *) top;
+        }
+    }
 
-    for(int i = 0; i < num_fields; i++) {
-        typeinfo->get_field(msg, i, &field);
+    const lcmtype_fields_t *fields = lcmtype_db_get_fields(db, metadata);
+    int64_t usertype_count = 0;
 
-        printf(LINE_FMT_STR, field.name, field.typestr);
+    size_t first = 0, end = SIZE_MAX;
+    if(viewport != NULL) {
+        first = viewport->first_line;
+        end = (viewport->num_lines < SIZE_MAX - first) ? first + viewport->num_lines : SIZE_MAX;
+    }
 
-        if(field.num_dim == 0)
-            print_value_scalar(db, &field, field.data, &usertype_count);
-        else
-            print_value_array(db, &field, field.data, &usertype_count);
+    strbuf_printf(out, "         Traversal: %s \n", cache->traversal);
+    strbuf_printf(out, "   ----------------------------------------------------------------\n");
+
+    // only the lines in the viewport are formatted, the others are counted
+    size_t line = 0;
+    for(int i = 0; i < fields->num_fields; i++) {
+        const lcmtype_field_t *field = &fields->fields[i];
+        void *data = (uint8_t *) msg + field->offset;
+        int is_user = (field->type == LCM_FIELD_USER_TYPE);
+
+        if(field->num_dim == 0) {
+            usertype_count += is_user;
+            if(first <= line && line < end) {
+                append_line_prefix(out, field->name, field->typestr);
+                print_value_scalar(out, field, data, usertype_count);
+                strbuf_append_char(out, '\n');
+            }
+            line++;
+            continue;
+        }
 
-        printf("\n");
+        array_layout_t layout;
+        array_layout(&layout, fields, field, msg);
+        size_t field_end = line + layout.num_lines;
+        for(size_t l = (first > line) ? first : line; l < field_end && l < end; l++) {
+            print_array_line(out, field, &layout, data, l - line, usertype_count + 1);
+            strbuf_append_char(out, '\n');
+        }
+        if(is_user)
+            usertype_count += layout.num_rows * layout.row_len;
+        line = field_end;
     }
+
+    return line;
 }
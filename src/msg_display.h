@@ -2,6 +2,7 @@
 #define MSG_DISPLAY_H
 
 #include "lcmtype_db.h"
+#include "strbuf.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -23,7 +24,41 @@ typedef struct
 
 } msg_display_state_t;
 
-void msg_display(lcmtype_db_t *db, const lcmtype_metadata_t *metadata, void *msg, const msg_display_state_t *state);
+/* the sub-message path last resolved for a msg_display_state_t, so that
+   redisplaying the same state skips the traversal. Owned by the caller
+   next to its state and zero-initialized; msg_display() keeps it current.
+*/
+#define MSG_DISPLAY_TRAVERSAL_BUFSZ 1024
+typedef struct
+{
+    int is_valid;
+    const lcmtype_metadata_t *metadata;
+    size_t cur_depth;
+    size_t recur_table[MSG_DISPLAY_RECUR_MAX];
+
+    const lcmtype_metadata_t *sub_metadata;
+    size_t sub_offset;
+    char traversal[MSG_DISPLAY_TRAVERSAL_BUFSZ];
+
+} msg_display_cache_t;
+
+/* the lines of the fields to display, e.g. those fitting on the screen.
+   The lines around it are only counted, not formatted, so the cost of a
+   display depends on the viewport rather than on the size of the message
+*/
+typedef struct
+{
+    size_t first_line;
+    size_t num_lines;
+
+} msg_display_viewport_t;
+
+// appends the display of 'msg' to 'out', only the lines in 'viewport' (NULL for all)
+// 'cache' may be NULL, the path is then resolved on every call
+// returns the number of lines of the fields (the header excluded), 0 on error
+size_t msg_display(strbuf_t *out, lcmtype_db_t *db, const lcmtype_metadata_t *metadata, void *msg,
+                   const msg_display_state_t *state, msg_display_cache_t *cache,
+                   const msg_display_viewport_t *viewport);
 
 #ifdef __cplusplus
 }
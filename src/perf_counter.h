@@ -0,0 +1,45 @@
+#ifndef PERF_COUNTER_H
+#define PERF_COUNTER_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* counts timed events (nanoseconds) for the self-timing screen
+   Updates are relaxed atomics: a few cycles, no locks, any number of
+   writer threads. Readers may see the fields from slightly different
+   moments, which is fine for display. */
+
+typedef struct
+{
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+
+} perf_counter_t;
+
+static inline void perf_counter_add(perf_counter_t *this, uint64_t ns)
+{
+    __atomic_fetch_add(&this->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&this->sum_ns, ns, __ATOMIC_RELAXED);
+
+    uint64_t max = __atomic_load_n(&this->max_ns, __ATOMIC_RELAXED);
+    while(ns > max && !__atomic_compare_exchange_n(&this->max_ns, &max, ns, 1,
+                                                   __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+static inline void perf_counter_get(const perf_counter_t *this, perf_counter_t *out)
+{
+    out->count = __atomic_load_n(&this->count, __ATOMIC_RELAXED);
+    out->sum_ns = __atomic_load_n(&this->sum_ns, __ATOMIC_RELAXED);
+    out->max_ns = __atomic_load_n(&this->max_ns, __ATOMIC_RELAXED);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* PERF_COUNTER_H */
@@ -0,0 +1,130 @@
+#include "rate_stats.h"
+
+#include <string.h>
+#include <math.h>
+
+/* below this many messages in the window, use the smoothed inter-arrival time */
+#define MIN_WINDOW_COUNT 8
+#define EWMA_WEIGHT (1.0 / 8.0)
+
+void rate_stats_init(rate_stats_t *this)
+{
+    memset(this, 0, sizeof(rate_stats_t));
+}
+
+static inline rate_bucket_t *get_bucket(rate_stats_t *this, uint64_t utime)
+{
+    uint64_t epoch = utime / RATE_STATS_BUCKET_PERIOD;
+    rate_bucket_t *b = &this->buckets[epoch % RATE_STATS_NUM_BUCKETS];
+
+    // recycle a stale bucket
+    if(b->epoch != epoch) {
+        memset(b, 0, sizeof(rate_bucket_t));
+        b->epoch = epoch;
+        b->dt_min = UINT32_MAX;
+    }
+
+    return b;
+}
+
+void rate_stats_add(rate_stats_t *this, uint64_t utime, uint32_t size)
+{
+    rate_bucket_t *b = get_bucket(this, utime);
+    b->count++;
+    b->bytes += size;
+
+    if(this->first_utime == 0) {
+        this->first_utime = utime;
+        this->last_utime = utime;
+        this->size_ewma = size;
+        return;
+    }
+
+    this->size_ewma += EWMA_WEIGHT * (size - this->size_ewma);
+
+    // the wall clock could step backwards
+    uint64_t dt64 = (utime > this->last_utime) ? utime - this->last_utime : 0;
+    uint32_t dt = (dt64 > UINT32_MAX) ? UINT32_MAX : (uint32_t) dt64;
+    this->last_utime = utime;
+
+    b->dt_count++;
+    if(dt < b->dt_min) b->dt_min = dt;
+    if(dt > b->dt_max) b->dt_max = dt;
+    b->dt_sum += dt;
+    b->dt_sumsq += (double) dt * dt;
+
+    if(this->dt_ewma == 0.0)
+        this->dt_ewma = dt;
+    else
+        this->dt_ewma += EWMA_WEIGHT * (dt - this->dt_ewma);
+}
+
+void rate_stats_get(const rate_stats_t *this, uint64_t now, rate_summary_t *summary)
+{
+    memset(summary, 0, sizeof(rate_summary_t));
+    if(this->first_utime == 0)
+        return;
+
+    // accumulate the buckets inside the window
+    uint64_t now_epoch = now / RATE_STATS_BUCKET_PERIOD;
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+    uint64_t dt_count = 0;
+    uint32_t dt_min = UINT32_MAX;
+    uint32_t dt_max = 0;
+    uint64_t dt_sum = 0;
+    double dt_sumsq = 0.0;
+
+    for(int i = 0; i < RATE_STATS_NUM_BUCKETS; i++) {
+        const rate_bucket_t *b = &this->buckets[i];
+        if(b->epoch > now_epoch || b->epoch + RATE_STATS_NUM_BUCKETS <= now_epoch)
+            continue;
+
+        count += b->count;
+        bytes += b->bytes;
+        dt_count += b->dt_count;
+        if(b->dt_count > 0) {
+            if(b->dt_min < dt_min) dt_min = b->dt_min;
+            if(b->dt_max > dt_max) dt_max = b->dt_max;
+            dt_sum += b->dt_sum;
+            dt_sumsq += b->dt_sumsq;
+        }
+    }
+
+    if(dt_count > 0) {
+        double mean = (double) dt_sum / dt_count;
+        double var = dt_sumsq / dt_count - mean * mean;
+        summary->dt_min = dt_min / 1000.0;
+        summary->dt_max = dt_max / 1000.0;
+        summary->dt_mean = mean / 1000.0;
+        summary->dt_stddev = (var > 0.0) ? sqrt(var) / 1000.0 : 0.0;
+    } else {
+        summary->dt_mean = this->dt_ewma / 1000.0;
+    }
+
+    // bandwidth follows from the rate and the average message size
+    double avg_size = (count > 0) ? (double) bytes / count : this->size_ewma;
+
+    // fast channels: count messages over the window
+    if(count >= MIN_WINDOW_COUNT) {
+        uint64_t window_start = (now_epoch + 1 - RATE_STATS_NUM_BUCKETS) * RATE_STATS_BUCKET_PERIOD;
+        if(this->first_utime >= window_start) {
+            // the channel started within the window, don't count the first message
+            window_start = this->first_utime;
+            count--;
+        }
+        if(now > window_start)
+            summary->hz = (float) count / ((float) (now - window_start) / 1000000.0);
+        summary->bytes_per_sec = summary->hz * avg_size;
+        return;
+    }
+
+    // slow channels: use the smoothed period, decaying once a message is overdue
+    if(this->dt_ewma > 0.0) {
+        double dt = this->dt_ewma;
+        if(now > this->last_utime && now - this->last_utime > dt)
+            dt = now - this->last_utime;
+        summary->hz = (float) (1000000.0 / dt);
+        summary->bytes_per_sec = summary->hz * avg_size;
+    }
+}
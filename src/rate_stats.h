@@ -0,0 +1,68 @@
+#ifndef RATE_STATS_H
+#define RATE_STATS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* constant-memory message rate estimator
+   Arrivals are counted in RATE_STATS_NUM_BUCKETS time buckets that
+   together cover RATE_STATS_PERIOD, so the estimate covers the same
+   window at 1 Hz and at 100 kHz. Channels too slow to fill the window
+   fall back to a smoothed inter-arrival time. Bytes are accounted
+   the same way to estimate the bandwidth.
+*/
+
+#define RATE_STATS_PERIOD      (4*1000*1000)  /* estimate over 4 sec of utimes */
+#define RATE_STATS_NUM_BUCKETS (8)
+#define RATE_STATS_BUCKET_PERIOD (RATE_STATS_PERIOD / RATE_STATS_NUM_BUCKETS)
+
+typedef struct
+{
+    uint64_t epoch;   // utime / RATE_STATS_BUCKET_PERIOD of this bucket
+    uint32_t count;
+    uint64_t bytes;
+
+    // inter-arrival times ending in this bucket (usec)
+    uint32_t dt_count;
+    uint32_t dt_min;
+    uint32_t dt_max;
+    uint64_t dt_sum;
+    double   dt_sumsq;
+
+} rate_bucket_t;
+
+typedef struct
+{
+    rate_bucket_t buckets[RATE_STATS_NUM_BUCKETS];
+    uint64_t first_utime;
+    uint64_t last_utime;
+    double dt_ewma;    // smoothed inter-arrival time (usec)
+    double size_ewma;  // smoothed message size (bytes)
+
+} rate_stats_t;
+
+typedef struct
+{
+    float hz;
+    float bytes_per_sec;
+
+    // inter-arrival times over the window (msec), 0 when unknown
+    float dt_min;
+    float dt_max;
+    float dt_mean;
+    float dt_stddev;
+
+} rate_summary_t;
+
+void rate_stats_init(rate_stats_t *this);
+void rate_stats_add(rate_stats_t *this, uint64_t utime, uint32_t size);
+void rate_stats_get(const rate_stats_t *this, uint64_t now, rate_summary_t *summary);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* RATE_STATS_H */
@@ -0,0 +1,62 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <stdint.h>
+#include <sched.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* a sequence lock for data with a single writer and any number of
+   readers: the writer never blocks, readers retry when they raced
+   with a write. Typical use:
+
+     writer:  seqlock_write_begin(&l); ...modify...; seqlock_write_end(&l);
+     reader:  do {
+                  s = seqlock_read_begin(&l);
+                  ...copy...
+              } while(seqlock_read_retry(&l, s));
+*/
+
+typedef struct
+{
+    uint32_t seq;  // odd while a write is in progress
+
+} seqlock_t;
+
+static inline void seqlock_init(seqlock_t *this)
+{
+    this->seq = 0;
+}
+
+static inline void seqlock_write_begin(seqlock_t *this)
+{
+    __atomic_store_n(&this->seq, this->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void seqlock_write_end(seqlock_t *this)
+{
+    __atomic_store_n(&this->seq, this->seq + 1, __ATOMIC_RELEASE);
+}
+
+static inline uint32_t seqlock_read_begin(const seqlock_t *this)
+{
+    uint32_t s;
+    while((s = __atomic_load_n(&this->seq, __ATOMIC_ACQUIRE)) & 1)
+        sched_yield();
+    return s;
+}
+
+static inline int seqlock_read_retry(const seqlock_t *this, uint32_t s)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&this->seq, __ATOMIC_RELAXED) != s;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* SEQLOCK_H */
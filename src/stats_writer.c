@@ -0,0 +1,196 @@
+#include "stats_writer.h"
+#include "strbuf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define CSV_HEADER "utime,channel,url,type,hash,count,hz,bytes_per_sec,total_bytes\n"
+
+struct stats_writer
+{
+    int fd;
+    int owns_fd;
+    enum stats_format format;
+    strbuf_t buf;
+    uint64_t utime;
+};
+
+static const char HEX[] = "0123456789abcdef";
+
+stats_writer_t *stats_writer_create(const char *filename, enum stats_format format)
+{
+    int fd = STDOUT_FILENO;
+    if(filename != NULL) {
+        fd = open(filename, O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if(fd < 0) {
+            fprintf(stderr, "ERR: failed to open '%s': %s\n", filename, strerror(errno));
+            return NULL;
+        }
+    }
+
+    stats_writer_t *this = calloc(1, sizeof(stats_writer_t));
+    this->fd = fd;
+    this->owns_fd = (filename != NULL);
+    this->format = format;
+    strbuf_init(&this->buf);
+
+    // a CSV header, unless we are appending to an existing file
+    if(format == STATS_FORMAT_CSV && lseek(fd, 0, SEEK_END) <= 0) {
+        strbuf_append_str(&this->buf, CSV_HEADER);
+        stats_writer_flush(this);
+    }
+
+    return this;
+}
+
+void stats_writer_destroy(stats_writer_t *this)
+{
+    if(this == NULL)
+        return;
+
+    if(this->owns_fd)
+        close(this->fd);
+    strbuf_cleanup(&this->buf);
+    free(this);
+}
+
+int stats_format_parse(const char *s, enum stats_format *format)
+{
+    if(strcmp(s, "jsonl") == 0 || strcmp(s, "json") == 0) {
+        *format = STATS_FORMAT_JSONL;
+        return 0;
+    }
+    if(strcmp(s, "csv") == 0) {
+        *format = STATS_FORMAT_CSV;
+        return 0;
+    }
+    return 1;
+}
+
+void stats_writer_begin(stats_writer_t *this, uint64_t utime)
+{
+    this->utime = utime;
+}
+
+static void append_json_string(strbuf_t *out, const char *s)
+{
+    strbuf_append_char(out, '"');
+    for(; *s; s++) {
+        unsigned char c = *s;
+        if(c == '"' || c == '\\') {
+            strbuf_append_char(out, '\\');
+            strbuf_append_char(out, c);
+        } else if(c < 0x20) {
+            strbuf_append(out, "\\u00", 4);
+            strbuf_append_char(out, HEX[c >> 4]);
+            strbuf_append_char(out, HEX[c & 0xf]);
+        } else {
+            strbuf_append_char(out, c);
+        }
+    }
+    strbuf_append_char(out, '"');
+}
+
+static void append_csv_field(strbuf_t *out, const char *s)
+{
+    if(strpbrk(s, ",\"\n\r") == NULL) {
+        strbuf_append_str(out, s);
+        return;
+    }
+
+    strbuf_append_char(out, '"');
+    for(; *s; s++) {
+        if(*s == '"')
+            strbuf_append_char(out, '"');
+        strbuf_append_char(out, *s);
+    }
+    strbuf_append_char(out, '"');
+}
+
+static void append_hash(strbuf_t *out, int64_t hash)
+{
+    uint64_t h = hash;
+    char tmp[18] = "0x";
+    for(int i = 0; i < 16; i++)
+        tmp[2+i] = HEX[(h >> (60 - 4*i)) & 0xf];
+    strbuf_append(out, tmp, sizeof(tmp));
+}
+
+void stats_writer_add(stats_writer_t *this, const stats_record_t *rec)
+{
+    strbuf_t *out = &this->buf;
+    const char *typename = (rec->typename != NULL) ? rec->typename : "";
+
+    if(this->format == STATS_FORMAT_JSONL) {
+        strbuf_append_str(out, "{\"utime\":");
+        strbuf_append_u64(out, this->utime);
+        strbuf_append_str(out, ",\"channel\":");
+        append_json_string(out, rec->channel);
+        strbuf_append_str(out, ",\"url\":");
+        if(rec->url != NULL)
+            append_json_string(out, rec->url);
+        else
+            strbuf_append_str(out, "null");
+        strbuf_append_str(out, ",\"type\":");
+        if(rec->typename != NULL)
+            append_json_string(out, typename);
+        else
+            strbuf_append_str(out, "null");
+        strbuf_append_str(out, ",\"hash\":\"");
+        append_hash(out, rec->hash);
+        strbuf_append_str(out, "\",\"count\":");
+        strbuf_append_u64(out, rec->num_msgs);
+        strbuf_append_str(out, ",\"hz\":");
+        strbuf_append_double(out, rec->hz, 3);
+        strbuf_append_str(out, ",\"bytes_per_sec\":");
+        strbuf_append_double(out, rec->bytes_per_sec, 1);
+        strbuf_append_str(out, ",\"total_bytes\":");
+        strbuf_append_u64(out, rec->num_bytes);
+        strbuf_append(out, "}\n", 2);
+    } else {
+        strbuf_append_u64(out, this->utime);
+        strbuf_append_char(out, ',');
+        append_csv_field(out, rec->channel);
+        strbuf_append_char(out, ',');
+        append_csv_field(out, (rec->url != NULL) ? rec->url : "");
+        strbuf_append_char(out, ',');
+        append_csv_field(out, typename);
+        strbuf_append_char(out, ',');
+        append_hash(out, rec->hash);
+        strbuf_append_char(out, ',');
+        strbuf_append_u64(out, rec->num_msgs);
+        strbuf_append_char(out, ',');
+        strbuf_append_double(out, rec->hz, 3);
+        strbuf_append_char(out, ',');
+        strbuf_append_double(out, rec->bytes_per_sec, 1);
+        strbuf_append_char(out, ',');
+        strbuf_append_u64(out, rec->num_bytes);
+        strbuf_append_char(out, '\n');
+    }
+}
+
+int stats_writer_flush(stats_writer_t *this)
+{
+    const char *p = this->buf.data;
+    size_t left = this->buf.len;
+    int ret = 0;
+
+    while(left > 0) {
+        ssize_t n = write(this->fd, p, left);
+        if(n < 0) {
+            if(errno == EINTR)
+                continue;
+            ret = 1;
+            break;
+        }
+        p += n;
+        left -= n;
+    }
+
+    strbuf_clear(&this->buf);
+    return ret;
+}
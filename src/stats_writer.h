@@ -0,0 +1,48 @@
+#ifndef STATS_WRITER_H
+#define STATS_WRITER_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* writes per-channel statistics as JSON Lines or CSV, for headless use.
+   Records are formatted into a memory buffer, a whole interval is then
+   written to the file descriptor with a single write().
+*/
+
+enum stats_format { STATS_FORMAT_JSONL, STATS_FORMAT_CSV };
+
+typedef struct
+{
+    const char *channel;
+    const char *url;       // the lcm url it was received on, NULL for the default
+    const char *typename;  // NULL when the type is unknown
+    int64_t hash;
+    uint64_t num_msgs;
+    uint64_t num_bytes;
+    double hz;
+    double bytes_per_sec;
+
+} stats_record_t;
+
+typedef struct stats_writer stats_writer_t;
+
+// 'filename' is appended to, or NULL for stdout
+stats_writer_t *stats_writer_create(const char *filename, enum stats_format format);
+void stats_writer_destroy(stats_writer_t *this);
+
+// returns 0 on success, accepts "jsonl" and "csv"
+int stats_format_parse(const char *s, enum stats_format *format);
+
+void stats_writer_begin(stats_writer_t *this, uint64_t utime);
+void stats_writer_add(stats_writer_t *this, const stats_record_t *rec);
+// returns 0 on success
+int stats_writer_flush(stats_writer_t *this);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* STATS_WRITER_H */
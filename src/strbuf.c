@@ -0,0 +1,205 @@
+#include "strbuf.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+
+#define STRBUF_INITIAL_ALLOC 4096
+
+void strbuf_init(strbuf_t *this)
+{
+    this->alloc = STRBUF_INITIAL_ALLOC;
+    this->data = malloc(this->alloc);
+    strbuf_clear(this);
+}
+
+void strbuf_cleanup(strbuf_t *this)
+{
+    free(this->data);
+    this->data = NULL;
+    this->len = 0;
+    this->alloc = 0;
+}
+
+void strbuf_reserve(strbuf_t *this, size_t n)
+{
+    if(this->len + n + 1 <= this->alloc)
+        return;
+
+    while(this->len + n + 1 > this->alloc)
+        this->alloc *= 2;
+    this->data = realloc(this->data, this->alloc);
+}
+
+void strbuf_append(strbuf_t *this, const char *s, size_t n)
+{
+    strbuf_reserve(this, n);
+    memcpy(this->data + this->len, s, n);
+    this->len += n;
+    this->data[this->len] = '\0';
+}
+
+void strbuf_printf(strbuf_t *this, const char *fmt, ...)
+{
+    va_list va;
+
+    va_start(va, fmt);
+    int n = vsnprintf(this->data + this->len, this->alloc - this->len, fmt, va);
+    va_end(va);
+    if(n < 0)
+        return;
+
+    // didn't fit? grow and format again
+    if(this->len + n + 1 > this->alloc) {
+        strbuf_reserve(this, n);
+        va_start(va, fmt);
+        vsnprintf(this->data + this->len, this->alloc - this->len, fmt, va);
+        va_end(va);
+    }
+
+    this->len += n;
+}
+
+void strbuf_append_str(strbuf_t *this, const char *s)
+{
+    strbuf_append(this, s, strlen(s));
+}
+
+static const char digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+void strbuf_append_u64(strbuf_t *this, uint64_t v)
+{
+    // format backwards, two digits at a time
+    char tmp[20];
+    char *p = tmp + sizeof(tmp);
+    while(v >= 100) {
+        int i = (v % 100) * 2;
+        v /= 100;
+        *--p = digit_pairs[i+1];
+        *--p = digit_pairs[i];
+    }
+    if(v >= 10) {
+        int i = v * 2;
+        *--p = digit_pairs[i+1];
+        *--p = digit_pairs[i];
+    } else {
+        *--p = '0' + v;
+    }
+
+    strbuf_append(this, p, tmp + sizeof(tmp) - p);
+}
+
+void strbuf_append_i64(strbuf_t *this, int64_t v)
+{
+    if(v < 0) {
+        strbuf_append_char(this, '-');
+        strbuf_append_u64(this, -(uint64_t) v);
+    } else {
+        strbuf_append_u64(this, v);
+    }
+}
+
+static const double pow10_table[] =
+    { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+
+static void append_double_printf(strbuf_t *this, double v, int decimals)
+{
+    char tmp[64];
+    int n = snprintf(tmp, sizeof(tmp), "%.*f", decimals, v);
+    if(n >= (int) sizeof(tmp)) {
+        strbuf_printf(this, "%.*f", decimals, v);
+        return;
+    }
+    strbuf_append(this, tmp, n);
+}
+
+void strbuf_append_double(strbuf_t *this, double v, int decimals)
+{
+    // integers are exact up to 2^53, beyond that (and for nan/inf) use the libc
+    double scale = pow10_table[decimals];
+    double a = fabs(v);
+    double scaled = a * scale;
+    if(!(scaled < 9007199254740992.0)) {
+        append_double_printf(this, v, decimals);
+        return;
+    }
+
+    // 'scaled' is off the exact product by half an ulp at most: unless it is
+    // that close to a tie, it rounds like the exact value. Near a tie, only
+    // the libc knows the exact decimal value (0.9075 is 0.90749999...)
+    double rounded = nearbyint(scaled);
+    if(fabs(fabs(scaled - rounded) - 0.5) <= scaled * 0x1p-52) {
+        append_double_printf(this, v, decimals);
+        return;
+    }
+
+    uint64_t iscale = (uint64_t) scale;
+    uint64_t ipart = (uint64_t) rounded / iscale;
+    uint64_t fpart = (uint64_t) rounded % iscale;
+
+    if(signbit(v))
+        strbuf_append_char(this, '-');
+    strbuf_append_u64(this, ipart);
+    if(decimals == 0)
+        return;
+
+    // fractional part, zero padded
+    strbuf_append_char(this, '.');
+    size_t start = this->len;
+    strbuf_append_u64(this, fpart);
+    size_t n = this->len - start;
+    if(n < decimals) {
+        strbuf_reserve(this, decimals - n);
+        memmove(this->data + start + (decimals - n), this->data + start, n + 1);
+        memset(this->data + start, '0', decimals - n);
+        this->len += decimals - n;
+    }
+}
+
+void strbuf_append_column(strbuf_t *this, const char *s, int width)
+{
+    size_t n = strnlen(s, width);
+    strbuf_reserve(this, width);
+    memcpy(this->data + this->len, s, n);
+    memset(this->data + this->len + n, ' ', width - n);
+    this->len += width;
+    this->data[this->len] = '\0';
+}
+
+void strbuf_ljust(strbuf_t *this, size_t start, int width)
+{
+    size_t n = this->len - start;
+    if(n >= width)
+        return;
+
+    size_t pad = width - n;
+    strbuf_reserve(this, pad);
+    memset(this->data + this->len, ' ', pad);
+    this->len += pad;
+    this->data[this->len] = '\0';
+}
+
+void strbuf_rjust(strbuf_t *this, size_t start, int width)
+{
+    size_t n = this->len - start;
+    if(n >= width)
+        return;
+
+    size_t pad = width - n;
+    strbuf_reserve(this, pad);
+    memmove(this->data + start + pad, this->data + start, n + 1);
+    memset(this->data + start, ' ', pad);
+    this->len += pad;
+}
@@ -0,0 +1,74 @@
+#ifndef STRBUF_H
+#define STRBUF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* a growable text buffer, reused from frame to frame so that
+   rendering doesn't allocate once it reached its working size.
+   The strbuf_append_*() formatters are hand-written equivalents of the
+   common printf() conversions, for the per-field hot paths. */
+
+typedef struct
+{
+    char *data;  // always '\0' terminated
+    size_t len;
+    size_t alloc;
+
+} strbuf_t;
+
+void strbuf_init(strbuf_t *this);
+void strbuf_cleanup(strbuf_t *this);
+
+static inline void strbuf_clear(strbuf_t *this)
+{
+    this->len = 0;
+    this->data[0] = '\0';
+}
+
+// drops what was appended after the first 'len' chars
+static inline void strbuf_truncate(strbuf_t *this, size_t len)
+{
+    this->len = len;
+    this->data[len] = '\0';
+}
+
+// make room for 'n' more chars (plus the terminator)
+void strbuf_reserve(strbuf_t *this, size_t n);
+
+void strbuf_append(strbuf_t *this, const char *s, size_t n);
+void strbuf_printf(strbuf_t *this, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static inline void strbuf_append_char(strbuf_t *this, char c)
+{
+    strbuf_reserve(this, 1);
+    this->data[this->len++] = c;
+    this->data[this->len] = '\0';
+}
+
+void strbuf_append_str(strbuf_t *this, const char *s);
+
+// like printf("%"PRIu64) and printf("%"PRIi64)
+void strbuf_append_u64(strbuf_t *this, uint64_t v);
+void strbuf_append_i64(strbuf_t *this, int64_t v);
+
+// like printf("%.*f", decimals, v), for 0 <= decimals <= 9
+void strbuf_append_double(strbuf_t *this, double v, int decimals);
+
+// like printf("%-*.*s", width, width, s)
+void strbuf_append_column(strbuf_t *this, const char *s, int width);
+
+// left/right-justify the text appended since 'start' in 'width' columns
+void strbuf_ljust(strbuf_t *this, size_t start, int width);
+void strbuf_rjust(strbuf_t *this, size_t start, int width);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* STRBUF_H */
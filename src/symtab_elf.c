@@ -2,78 +2,139 @@
 
 #include <stdlib.h>
 #include <stdio.h>
-#include <inttypes.h>
-#include <ctype.h>
-#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// we only read native ELF files, they are dlopen()'ed afterwards anyway
+#if UINTPTR_MAX > 0xffffffff
+  #define ELF_CLASS ELFCLASS64
+  typedef Elf64_Ehdr Elf_Ehdr;
+  typedef Elf64_Shdr Elf_Shdr;
+  typedef Elf64_Sym  Elf_Sym;
+  #define ELF_ST_TYPE(i) ELF64_ST_TYPE(i)
+  #define ELF_ST_BIND(i) ELF64_ST_BIND(i)
+#else
+  #define ELF_CLASS ELFCLASS32
+  typedef Elf32_Ehdr Elf_Ehdr;
+  typedef Elf32_Shdr Elf_Shdr;
+  typedef Elf32_Sym  Elf_Sym;
+  #define ELF_ST_TYPE(i) ELF32_ST_TYPE(i)
+  #define ELF_ST_BIND(i) ELF32_ST_BIND(i)
+#endif
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  #define ELF_DATA ELFDATA2LSB
+#else
+  #define ELF_DATA ELFDATA2MSB
+#endif
 
-#define MAXBUF 256
-
-typedef struct
+struct symtab_elf_iter
 {
-    char *data;
-    size_t datasz;
-    size_t len;
+    uint8_t *map;
+    size_t mapsz;
 
-} string_t;
-
-static inline string_t *string_create(void)
-{
-    string_t *this = calloc(1, sizeof(string_t));
-    this->datasz = 8;
-    this->data = malloc(this->datasz * sizeof(char));
-    this->data[0] = '\0';
-    this->len = 0;
+    const Elf_Sym *syms;
+    size_t num_syms;
+    const char *strtab;
+    size_t strtabsz;
 
-    return this;
-}
+    size_t index;
+};
 
-static inline void string_append(string_t *this, char c)
+static const Elf_Shdr *find_section(const Elf_Shdr *shdrs, size_t shnum, uint32_t type)
 {
-    // do we need to reallocate?
-    if(this->len+1 == this->datasz) {
-        this->datasz *= 2;
-        this->data = realloc(this->data, this->datasz);
-    }
-
-    this->data[this->len++] = c;
-    this->data[this->len] = '\0';
+    for(size_t i = 0; i < shnum; i++)
+        if(shdrs[i].sh_type == type)
+            return &shdrs[i];
+    return NULL;
 }
 
-static inline void string_clear(string_t *this)
+static inline int in_bounds(size_t mapsz, uint64_t off, uint64_t sz)
 {
-    this->len = 0;
-    this->data[this->len] = '\0';
+    return off <= mapsz && sz <= mapsz - off;
 }
 
-static inline void string_destroy(string_t *this)
+// locate the symbol table and its string table inside the mapped file
+// returns success (0) or failure (1)
+static int parse_elf(symtab_elf_iter_t *this)
 {
-    free(this->data);
-    free(this);
-}
+    const uint8_t *map = this->map;
+    size_t mapsz = this->mapsz;
 
-struct symtab_elf_iter
-{
-    FILE *f;
+    if(mapsz < sizeof(Elf_Ehdr) || memcmp(map, ELFMAG, SELFMAG) != 0)
+        return 1;
 
-    char buffer[MAXBUF];
-    int num_read;
-    int index;
+    const Elf_Ehdr *ehdr = (const Elf_Ehdr *) map;
+    if(ehdr->e_ident[EI_CLASS] != ELF_CLASS || ehdr->e_ident[EI_DATA] != ELF_DATA)
+        return 1;
+    if(ehdr->e_shoff == 0 || ehdr->e_shentsize != sizeof(Elf_Shdr))
+        return 1;
+    if(!in_bounds(mapsz, ehdr->e_shoff, sizeof(Elf_Shdr)))
+        return 1;
 
-    string_t *s;
-};
+    const Elf_Shdr *shdrs = (const Elf_Shdr *) (map + ehdr->e_shoff);
+
+    // with extended numbering, the real count is in the first section header
+    size_t shnum = ehdr->e_shnum;
+    if(shnum == 0)
+        shnum = shdrs[0].sh_size;
+    if(!in_bounds(mapsz, ehdr->e_shoff, (uint64_t) shnum * sizeof(Elf_Shdr)))
+        return 1;
+
+    // prefer the dynamic symbols: exactly what dlsym() can resolve
+    const Elf_Shdr *symsec = find_section(shdrs, shnum, SHT_DYNSYM);
+    if(symsec == NULL)
+        symsec = find_section(shdrs, shnum, SHT_SYMTAB);
+    if(symsec == NULL || symsec->sh_entsize != sizeof(Elf_Sym) || symsec->sh_link >= shnum)
+        return 1;
+
+    const Elf_Shdr *strsec = &shdrs[symsec->sh_link];
+    if(!in_bounds(mapsz, symsec->sh_offset, symsec->sh_size) ||
+       !in_bounds(mapsz, strsec->sh_offset, strsec->sh_size) ||
+       strsec->sh_size == 0)
+        return 1;
+
+    this->syms = (const Elf_Sym *) (map + symsec->sh_offset);
+    this->num_syms = symsec->sh_size / sizeof(Elf_Sym);
+    this->strtab = (const char *) (map + strsec->sh_offset);
+    this->strtabsz = strsec->sh_size;
+
+    return 0;
+}
 
 symtab_elf_iter_t *symtab_elf_iter_create(const char *libname)
 {
-    FILE *f = fopen(libname, "rb");
-    if(f == NULL)
+    int fd = open(libname, O_RDONLY);
+    if(fd < 0)
+        return NULL;
+
+    struct stat st;
+    if(fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
         return NULL;
+    }
 
-    // successfully opened!
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED)
+        return NULL;
+
+    // successfully mapped!
     symtab_elf_iter_t *this = calloc(1, sizeof(symtab_elf_iter_t));
-    this->f = f;
-    this->num_read = 0;
+    this->map = map;
+    this->mapsz = st.st_size;
     this->index = 0;
-    this->s = string_create();
+
+    if(parse_elf(this) != 0) {
+        fprintf(stderr, "ERR: '%s' is not a native ELF file with a symbol table\n", libname);
+        symtab_elf_iter_destroy(this);
+        return NULL;
+    }
 
     return this;
 }
@@ -83,79 +144,37 @@ void symtab_elf_iter_destroy(symtab_elf_iter_t *this)
     if(this == NULL)
         return;
 
-    fclose(this->f);
-    string_destroy(this->s);
+    munmap(this->map, this->mapsz);
     free(this);
 }
 
-
-// returns success (0) or failure (1)
-static inline int refill_buffer(symtab_elf_iter_t *this)
-{
-    assert(this->num_read == this->index);
-    int n = fread(this->buffer, 1, MAXBUF, this->f);
-    if(n == 0)
-        return 1;
-
-    this->num_read = n;
-    this->index = 0;
-    return 0;
-}
-
-static inline int is_ident_char(uint8_t ch)
-{
-    return isalpha(ch) || isdigit(ch) || ch == '_';
-}
-
-static inline int is_first_ident_char(uint8_t ch)
-{
-    return isalpha(ch) || ch == '_';
-}
-
-// a very crude symbol extraction method
-// we simply search for byte sequences that look like valid
-// C language identifiers
+// iterates the defined, externally visible functions
+// the returned string points into the mapped file: no copies are made
 const char *symtab_elf_iter_get_next(symtab_elf_iter_t *this)
 {
     if(this == NULL)
         return NULL;
 
-    // cleanup the last string
-    string_clear(this->s);
-
-    while(1) {
+    while(this->index < this->num_syms) {
+        const Elf_Sym *sym = &this->syms[this->index++];
 
-        while(this->index < this->num_read) {
-            uint8_t c = this->buffer[this->index++];
+        if(ELF_ST_TYPE(sym->st_info) != STT_FUNC || sym->st_shndx == SHN_UNDEF)
+            continue;
 
-            // null byte, end of a string?
-            if(c == '\0') {
-                if(this->s->len > 0) {
-                    return this->s->data;
-                }
-            }
+        int bind = ELF_ST_BIND(sym->st_info);
+        if(bind != STB_GLOBAL && bind != STB_WEAK)
+            continue;
 
-            // is it an identifier char?
-            else if(this->s->len > 0 && is_ident_char(c)) {
-                string_append(this->s, c);
-            }
+        if(sym->st_name == 0 || sym->st_name >= this->strtabsz)
+            continue;
 
-            else if(this->s->len == 0 && is_first_ident_char(c)) {
-                string_append(this->s, c);
-            }
-
-            // otherwise its garbage, reset the string
-            else {
-                string_clear(this->s);
-            }
-        }
-
-        // we've exhausted the buffer, let's try to get more...
-        int res = refill_buffer(this);
-        if(res != 0) {
-            // end-of-file or error
-            return NULL;
-        }
+        // the name must be terminated inside the string table
+        const char *name = this->strtab + sym->st_name;
+        if(memchr(name, '\0', this->strtabsz - sym->st_name) == NULL)
+            continue;
 
+        return name;
     }
+
+    return NULL;
 }
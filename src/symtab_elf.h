@@ -9,6 +9,8 @@ typedef struct symtab_elf_iter symtab_elf_iter_t;
 
 symtab_elf_iter_t *symtab_elf_iter_create(const char *libname);
 void symtab_elf_iter_destroy(symtab_elf_iter_t *this);
+// returns the next exported function name, or NULL when done
+// the string remains valid until symtab_elf_iter_destroy()
 const char *symtab_elf_iter_get_next(symtab_elf_iter_t *this);
 
 #ifdef __cplusplus
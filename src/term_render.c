@@ -0,0 +1,247 @@
+#include "term_render.h"
+#include "strbuf.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#define TAB_WIDTH 8
+
+typedef struct
+{
+    strbuf_t text;   // normalized lines, without their '\n'
+    size_t *starts;  // num_lines+1 offsets into text
+    int num_lines;
+    int alloc_lines;
+
+} frame_t;
+
+struct term_render
+{
+    int fd;
+    int rows;  // terminal size, 0 if unknown
+    int cols;
+
+    frame_t prev;   // what's on screen
+    frame_t cur;    // scratch for the new frame
+    int is_valid;   // does 'prev' match the screen?
+
+    strbuf_t out;
+    uint64_t bytes_written;
+};
+
+static void frame_init(frame_t *f)
+{
+    strbuf_init(&f->text);
+    f->alloc_lines = 64;
+    f->starts = malloc((f->alloc_lines + 1) * sizeof(size_t));
+    f->num_lines = 0;
+    f->starts[0] = 0;
+}
+
+static void frame_cleanup(frame_t *f)
+{
+    strbuf_cleanup(&f->text);
+    free(f->starts);
+}
+
+static inline void frame_end_line(frame_t *f)
+{
+    if(f->num_lines == f->alloc_lines) {
+        f->alloc_lines *= 2;
+        f->starts = realloc(f->starts, (f->alloc_lines + 1) * sizeof(size_t));
+    }
+    f->starts[++f->num_lines] = f->text.len;
+}
+
+static inline const char *frame_line(const frame_t *f, int i, size_t *len)
+{
+    *len = f->starts[i+1] - f->starts[i];
+    return f->text.data + f->starts[i];
+}
+
+// split into lines, expand tabs and clip to the terminal size
+static void frame_load(frame_t *f, const char *s, size_t len, int rows, int cols)
+{
+    strbuf_clear(&f->text);
+    f->num_lines = 0;
+    f->starts[0] = 0;
+
+    // wide enough for a full line of expanded tabs
+    strbuf_reserve(&f->text, len * TAB_WIDTH);
+
+    char *out = f->text.data;
+    int col = 0;
+    int is_clipping = 0; /* false */
+    for(size_t i = 0; i < len; i++) {
+        char c = s[i];
+        if(c == '\n') {
+            f->text.len = out - f->text.data;
+            frame_end_line(f);
+            col = 0;
+            is_clipping = 0; /* false */
+            if(rows > 0 && f->num_lines == rows)
+                break;
+            continue;
+        }
+
+        // utf-8 continuation bytes don't take a column, and go with their
+        // lead byte: characters are clipped whole, never leaving invalid utf-8
+        if(((uint8_t) c & 0xC0) == 0x80) {
+            if(!is_clipping)
+                *out++ = c;
+            continue;
+        }
+
+        is_clipping = (cols > 0 && col >= cols);
+        if(is_clipping)
+            continue;
+
+        if(c == '\t') {
+            do {
+                *out++ = ' ';
+            } while(++col % TAB_WIDTH != 0 && !(cols > 0 && col >= cols));
+        } else {
+            *out++ = c;
+            col++;
+        }
+    }
+
+    // the last (possibly empty) line has no '\n'
+    if(!(rows > 0 && f->num_lines == rows)) {
+        f->text.len = out - f->text.data;
+        frame_end_line(f);
+    }
+    f->text.data[f->text.len] = '\0';
+}
+
+term_render_t *term_render_create(int fd)
+{
+    term_render_t *this = calloc(1, sizeof(term_render_t));
+    this->fd = fd;
+    frame_init(&this->prev);
+    frame_init(&this->cur);
+    strbuf_init(&this->out);
+    this->is_valid = 0; /* false */
+    this->bytes_written = 0;
+    return this;
+}
+
+void term_render_destroy(term_render_t *this)
+{
+    if(this == NULL)
+        return;
+
+    frame_cleanup(&this->prev);
+    frame_cleanup(&this->cur);
+    strbuf_cleanup(&this->out);
+    free(this);
+}
+
+void term_render_invalidate(term_render_t *this)
+{
+    this->is_valid = 0; /* false */
+}
+
+static void update_size(term_render_t *this)
+{
+    struct winsize ws;
+    int rows = 0, cols = 0;
+    if(ioctl(this->fd, TIOCGWINSZ, &ws) == 0) {
+        rows = ws.ws_row;
+        cols = ws.ws_col;
+    }
+
+    if(rows != this->rows || cols != this->cols) {
+        this->rows = rows;
+        this->cols = cols;
+        this->is_valid = 0; /* false */
+    }
+}
+
+static void write_all(term_render_t *this, const char *data, size_t len)
+{
+    while(len > 0) {
+        ssize_t n = write(this->fd, data, len);
+        if(n < 0) {
+            if(errno == EINTR)
+                continue;
+            this->is_valid = 0; /* false */
+            return;
+        }
+        data += n;
+        len -= n;
+        this->bytes_written += n;
+    }
+}
+
+size_t term_render_frame(term_render_t *this, const char *frame, size_t len)
+{
+    update_size(this);
+    frame_load(&this->cur, frame, len, this->rows, this->cols);
+
+    strbuf_t *out = &this->out;
+    strbuf_clear(out);
+
+    int nprev = 0;
+    if(this->is_valid) {
+        nprev = this->prev.num_lines;
+    } else {
+        strbuf_append(out, "\033[H\033[2J", 7);
+    }
+
+    // emit the changed lines
+    for(int i = 0; i < this->cur.num_lines; i++) {
+        size_t n, pn;
+        const char *line = frame_line(&this->cur, i, &n);
+        if(i < nprev) {
+            const char *pline = frame_line(&this->prev, i, &pn);
+            if(n == pn && memcmp(line, pline, n) == 0)
+                continue;
+        } else if(n == 0 && this->is_valid) {
+            continue;  // new empty line on a cleared part of the screen
+        }
+
+        strbuf_printf(out, "\033[%d;1H", i + 1);
+        strbuf_append(out, line, n);
+        strbuf_append(out, "\033[K", 3);
+    }
+
+    // clear what's left of a longer previous frame
+    if(nprev > this->cur.num_lines)
+        strbuf_printf(out, "\033[%d;1H\033[J", this->cur.num_lines + 1);
+
+    // leave the cursor at the end of the frame
+    if(out->len > 0) {
+        size_t n;
+        int last = this->cur.num_lines - 1;
+        frame_line(&this->cur, last, &n);
+        strbuf_printf(out, "\033[%d;%dH", last + 1, (int) n + 1);
+    }
+
+    // the new frame is now on screen
+    frame_t tmp = this->prev;
+    this->prev = this->cur;
+    this->cur = tmp;
+    this->is_valid = 1; /* true */
+
+    uint64_t before = this->bytes_written;
+    if(out->len > 0)
+        write_all(this, out->data, out->len);
+
+    return this->bytes_written - before;
+}
+
+uint64_t term_render_get_bytes_written(const term_render_t *this)
+{
+    return this->bytes_written;
+}
+
+void term_render_get_size(term_render_t *this, int *rows, int *cols)
+{
+    update_size(this);
+    *rows = this->rows;
+    *cols = this->cols;
+}
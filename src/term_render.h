@@ -0,0 +1,39 @@
+#ifndef TERM_RENDER_H
+#define TERM_RENDER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* differential terminal renderer
+   Each frame is a complete screen of '\n' separated text. It is compared
+   against the previous frame and only the lines that changed are sent,
+   using cursor-movement escapes, in a single write(). Tabs are expanded
+   and lines are clipped to the terminal size so that rows never shift.
+*/
+
+typedef struct term_render term_render_t;
+
+term_render_t *term_render_create(int fd);
+void term_render_destroy(term_render_t *this);
+
+// forget what's on screen: the next frame is fully redrawn
+void term_render_invalidate(term_render_t *this);
+
+// returns the number of bytes written to the terminal
+size_t term_render_frame(term_render_t *this, const char *frame, size_t len);
+
+uint64_t term_render_get_bytes_written(const term_render_t *this);
+
+// the terminal size, queried again on every call, 0 when unknown
+// a change also invalidates the screen
+void term_render_get_size(term_render_t *this, int *rows, int *cols);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* TERM_RENDER_H */
@@ -2,6 +2,7 @@
 
 #include <stdlib.h>
 #include <sys/time.h>
+#include <time.h>
 
 uint64_t timestamp_now(void)
 {
@@ -9,3 +10,28 @@ uint64_t timestamp_now(void)
     gettimeofday(&tv, NULL);
     return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
 }
+
+static inline uint64_t monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void tmr_tic(ss_timer_t *this)
+{
+    this->tic_time = monotonic_ns();
+}
+
+uint64_t tmr_toc(ss_timer_t *this)
+{
+    return monotonic_ns() - this->tic_time;
+}
+
+uint64_t tmr_toc_tic(ss_timer_t *this)
+{
+    uint64_t now = monotonic_ns();
+    uint64_t elapsed = now - this->tic_time;
+    this->tic_time = now;
+    return elapsed;
+}
@@ -16,6 +16,9 @@ typedef struct
 
 uint64_t timestamp_now(void);
 
+/* interval timers on the monotonic clock, in nanoseconds
+   tmr_toc() returns the time since the last tic, tmr_toc_tic() also
+   restarts the timer, to time consecutive steps */
 void   tmr_tic(ss_timer_t*);
 uint64_t tmr_toc(ss_timer_t*);
 uint64_t tmr_toc_tic(ss_timer_t*);
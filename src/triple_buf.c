@@ -0,0 +1,60 @@
+#include "triple_buf.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define TRIPLE_BUF_FRESH 0x4
+#define TRIPLE_BUF_INDEX 0x3
+
+void triple_buf_init(triple_buf_t *this)
+{
+    memset(this->slots, 0, sizeof(this->slots));
+    this->back = 0;
+    this->middle = 1;
+    this->front = 2;
+    this->has_read = 0; /* false */
+}
+
+void triple_buf_cleanup(triple_buf_t *this)
+{
+    for(int i = 0; i < 3; i++) {
+        free(this->slots[i].data);
+        this->slots[i].data = NULL;
+        this->slots[i].alloc = 0;
+    }
+}
+
+triple_buf_slot_t *triple_buf_write_slot(triple_buf_t *this, size_t size)
+{
+    triple_buf_slot_t *slot = &this->slots[this->back];
+    if(slot->alloc < size) {
+        slot->alloc = size;
+        slot->data = realloc(slot->data, slot->alloc);
+    }
+    slot->size = size;
+    return slot;
+}
+
+void triple_buf_publish(triple_buf_t *this)
+{
+    uint8_t prev = __atomic_exchange_n(&this->middle, this->back | TRIPLE_BUF_FRESH,
+                                       __ATOMIC_ACQ_REL);
+    this->back = prev & TRIPLE_BUF_INDEX;
+}
+
+triple_buf_slot_t *triple_buf_read(triple_buf_t *this, int *is_new)
+{
+    *is_new = 0; /* false */
+
+    if(__atomic_load_n(&this->middle, __ATOMIC_ACQUIRE) & TRIPLE_BUF_FRESH) {
+        uint8_t prev = __atomic_exchange_n(&this->middle, this->front, __ATOMIC_ACQ_REL);
+        this->front = prev & TRIPLE_BUF_INDEX;
+        this->has_read = 1; /* true */
+        *is_new = 1; /* true */
+    }
+
+    if(!this->has_read)
+        return NULL;
+
+    return &this->slots[this->front];
+}
@@ -0,0 +1,52 @@
+#ifndef TRIPLE_BUF_H
+#define TRIPLE_BUF_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* a lock-free "latest value" mailbox between exactly one writer thread
+   and one reader thread. The writer fills its private slot and publishes
+   it with a pointer swap, the reader always gets the most recently
+   published slot. Neither side ever blocks or copies the other's data.
+*/
+
+typedef struct
+{
+    uint8_t *data;
+    size_t size;
+    size_t alloc;
+    const void *tag;  // user data published along with the buffer
+
+} triple_buf_slot_t;
+
+typedef struct
+{
+    triple_buf_slot_t slots[3];
+    uint8_t back;     // owned by the writer
+    uint8_t front;    // owned by the reader
+    uint8_t middle;   // shared: slot index | TRIPLE_BUF_FRESH
+    uint8_t has_read; // owned by the reader
+
+} triple_buf_t;
+
+void triple_buf_init(triple_buf_t *this);
+void triple_buf_cleanup(triple_buf_t *this);
+
+/* writer: get the private slot, resized to hold 'size' bytes */
+triple_buf_slot_t *triple_buf_write_slot(triple_buf_t *this, size_t size);
+/* writer: publish the private slot */
+void triple_buf_publish(triple_buf_t *this);
+
+/* reader: returns the latest published slot, or NULL if nothing was
+   ever published. *is_new is set if it changed since the last call */
+triple_buf_slot_t *triple_buf_read(triple_buf_t *this, int *is_new);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* TRIPLE_BUF_H */
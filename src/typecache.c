@@ -0,0 +1,259 @@
+#include "typecache.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <glib.h>
+
+#define TYPECACHE_MAGIC "lcm-spy-lite typecache v1"
+
+/* the shortest type line: "<hash> <typename>\n" with one digit and one character */
+#define TYPECACHE_MIN_LINE 4
+
+typedef struct
+{
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+
+    int count;
+    char **names;
+    int64_t *hashes;
+
+} typecache_entry_t;
+
+struct typecache
+{
+    char *filename;
+    GHashTable *entries;  // library path -> typecache_entry_t
+    int is_dirty;
+};
+
+static void entry_destroy(typecache_entry_t *e)
+{
+    for(int i = 0; i < e->count; i++)
+        free(e->names[i]);
+    free(e->names);
+    free(e->hashes);
+    free(e);
+}
+
+// returns NULL when out of memory
+static typecache_entry_t *entry_create(const struct stat *st, int count)
+{
+    typecache_entry_t *e = calloc(1, sizeof(typecache_entry_t));
+    if(e == NULL)
+        return NULL;
+    e->dev = st->st_dev;
+    e->ino = st->st_ino;
+    e->size = st->st_size;
+    e->mtime_sec = st->st_mtim.tv_sec;
+    e->mtime_nsec = st->st_mtim.tv_nsec;
+    e->count = count;
+    e->names = calloc((size_t) count + 1, sizeof(char *));
+    e->hashes = calloc((size_t) count + 1, sizeof(int64_t));
+    if(e->names == NULL || e->hashes == NULL) {
+        e->count = 0;
+        entry_destroy(e);
+        return NULL;
+    }
+    return e;
+}
+
+static int entry_is_fresh(const typecache_entry_t *e, const struct stat *st)
+{
+    return e->dev == (uint64_t) st->st_dev
+        && e->ino == (uint64_t) st->st_ino
+        && e->size == (uint64_t) st->st_size
+        && e->mtime_sec == (int64_t) st->st_mtim.tv_sec
+        && e->mtime_nsec == (int64_t) st->st_mtim.tv_nsec;
+}
+
+static inline void chomp(char *line)
+{
+    size_t len = strlen(line);
+    if(len > 0 && line[len-1] == '\n')
+        line[len-1] = '\0';
+}
+
+// returns success (0) or failure (1), on failure the cache is left empty
+// 'filesz' bounds the counts read from the file, which may be corrupt
+static int parse_file(typecache_t *this, FILE *f, uint64_t filesz)
+{
+    char *line = NULL;
+    size_t linesz = 0;
+
+    if(getline(&line, &linesz, f) < 0)
+        goto fail;
+    chomp(line);
+    if(strcmp(line, TYPECACHE_MAGIC) != 0)
+        goto fail;
+
+    while(getline(&line, &linesz, f) >= 0) {
+        chomp(line);
+
+        // library header: L <dev> <ino> <size> <mtime_sec> <mtime_nsec> <count> <path>
+        struct stat st;
+        uint64_t dev, ino, size;
+        int64_t mtime_sec, mtime_nsec;
+        int count, pathpos;
+        if(sscanf(line, "L %"SCNu64" %"SCNu64" %"SCNu64" %"SCNd64" %"SCNd64" %d %n",
+                  &dev, &ino, &size, &mtime_sec, &mtime_nsec, &count, &pathpos) != 6)
+            goto fail;
+        if(count < 0 || (uint64_t) count > filesz / TYPECACHE_MIN_LINE || line[pathpos] == '\0')
+            goto fail;
+
+        memset(&st, 0, sizeof(st));
+        typecache_entry_t *e = entry_create(&st, count);
+        if(e == NULL)
+            goto fail;
+        e->dev = dev;
+        e->ino = ino;
+        e->size = size;
+        e->mtime_sec = mtime_sec;
+        e->mtime_nsec = mtime_nsec;
+        g_hash_table_replace(this->entries, strdup(line + pathpos), e);
+
+        // followed by one line per type: <hash> <typename>
+        for(int i = 0; i < count; i++) {
+            char name[256];
+            uint64_t hash;
+            if(getline(&line, &linesz, f) < 0 ||
+               sscanf(line, "%"SCNx64" %255s", &hash, name) != 2)
+                goto fail;
+            e->hashes[i] = (int64_t) hash;
+            e->names[i] = strdup(name);
+        }
+    }
+
+    free(line);
+    return 0;
+
+ fail:
+    free(line);
+    g_hash_table_remove_all(this->entries);
+    return 1;
+}
+
+typecache_t *typecache_load(const char *filename)
+{
+    typecache_t *this = calloc(1, sizeof(typecache_t));
+    this->filename = strdup(filename);
+    this->entries = g_hash_table_new_full(g_str_hash, g_str_equal,
+                        free, (GDestroyNotify) entry_destroy);
+    this->is_dirty = 0; /* false */
+
+    FILE *f = fopen(filename, "r");
+    if(f == NULL)
+        return this;
+
+    // in a shared directory, another user could have written it
+    struct stat st;
+    if(fstat(fileno(f), &st) != 0 || st.st_uid != getuid()) {
+        fprintf(stderr, "WRN: ignoring type cache '%s', not owned by this user\n", filename);
+        fclose(f);
+        this->is_dirty = 1; /* true */
+        return this;
+    }
+
+    if(parse_file(this, f, st.st_size) != 0) {
+        fprintf(stderr, "WRN: ignoring corrupt type cache '%s'\n", filename);
+        this->is_dirty = 1; /* true */
+    }
+
+    fclose(f);
+    return this;
+}
+
+void typecache_destroy(typecache_t *this)
+{
+    if(this == NULL)
+        return;
+
+    g_hash_table_destroy(this->entries);
+    free(this->filename);
+    free(this);
+}
+
+int typecache_lookup(typecache_t *this, const char *libname, const struct stat *st,
+                     char * const **names, const int64_t **hashes)
+{
+    typecache_entry_t *e = g_hash_table_lookup(this->entries, libname);
+    if(e == NULL || !entry_is_fresh(e, st))
+        return -1;
+
+    *names = e->names;
+    *hashes = e->hashes;
+    return e->count;
+}
+
+void typecache_update(typecache_t *this, const char *libname, const struct stat *st,
+                      int count, char * const *names, const int64_t *hashes)
+{
+    typecache_entry_t *e = entry_create(st, count);
+    if(e == NULL)
+        return;  // not cached, the library is scanned again next time
+    for(int i = 0; i < count; i++) {
+        e->names[i] = strdup(names[i]);
+        e->hashes[i] = hashes[i];
+    }
+
+    g_hash_table_replace(this->entries, strdup(libname), e);
+    this->is_dirty = 1; /* true */
+}
+
+int typecache_save(typecache_t *this)
+{
+    if(!this->is_dirty)
+        return 0;
+
+    // write a temporary file and rename it over the old one. mkstemp()
+    // creates it exclusively, so nobody can plant a symlink in its place
+    size_t sz = strlen(this->filename) + sizeof(".XXXXXX");
+    char *tmpname = malloc(sz);
+    snprintf(tmpname, sz, "%s.XXXXXX", this->filename);
+
+    int fd = mkstemp(tmpname);
+    if(fd < 0) {
+        free(tmpname);
+        return 1;
+    }
+    FILE *f = fdopen(fd, "w");
+    if(f == NULL) {
+        close(fd);
+        unlink(tmpname);
+        free(tmpname);
+        return 1;
+    }
+
+    fprintf(f, "%s\n", TYPECACHE_MAGIC);
+
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, this->entries);
+    while(g_hash_table_iter_next(&iter, &key, &value)) {
+        const typecache_entry_t *e = value;
+        fprintf(f, "L %"PRIu64" %"PRIu64" %"PRIu64" %"PRId64" %"PRId64" %d %s\n",
+                e->dev, e->ino, e->size, e->mtime_sec, e->mtime_nsec, e->count, (char *) key);
+        for(int i = 0; i < e->count; i++)
+            fprintf(f, "%016"PRIx64" %s\n", (uint64_t) e->hashes[i], e->names[i]);
+    }
+
+    int err = ferror(f);
+    if(fclose(f) != 0)
+        err = 1;
+
+    if(err || rename(tmpname, this->filename) != 0) {
+        unlink(tmpname);
+        free(tmpname);
+        return 1;
+    }
+
+    free(tmpname);
+    this->is_dirty = 0; /* false */
+    return 0;
+}
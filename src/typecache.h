@@ -0,0 +1,41 @@
+#ifndef TYPECACHE_H
+#define TYPECACHE_H
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* on-disk catalog of the lcmtypes found in each library
+   Entries are keyed by the library's path, device, inode, size and
+   mtime, so a library that changed on disk is detected as stale and
+   rescanned. Lookups are read-only and may run on several threads;
+   updates and saving must happen on a single thread.
+*/
+
+typedef struct typecache typecache_t;
+
+// never returns NULL: a missing or corrupt file gives an empty cache
+typecache_t *typecache_load(const char *filename);
+void typecache_destroy(typecache_t *this);
+
+// returns the number of cached types for 'libname' and points *names and
+// *hashes to them (owned by the cache), or -1 if there's no fresh entry
+int typecache_lookup(typecache_t *this, const char *libname, const struct stat *st,
+                     char * const **names, const int64_t **hashes);
+
+// replace the entry for 'libname' (the strings are copied)
+void typecache_update(typecache_t *this, const char *libname, const struct stat *st,
+                      int count, char * const *names, const int64_t *hashes);
+
+// atomically rewrite the file if anything was updated
+// returns success (0) or failure (1)
+int typecache_save(typecache_t *this);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* TYPECACHE_H */
@@ -0,0 +1,305 @@
+#include "watch.h"
+#include "seqlock.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+struct watch
+{
+    char *path;
+    const char *channel;     // the bound channel's name (compared by pointer only)
+
+    /* owned by the writer: the bound channel's thread. During a rebinding,
+       the previous channel's thread may still be writing, hence the mutex
+       (never contended otherwise) */
+    pthread_mutex_t writer_mutex;
+    const char *writer;      // the channel the values come from
+    const char *field_path;  // after the writer's channel
+    int is_compiled;
+    int64_t offset;
+    lcm_field_type_t type;
+    const char *error;       // published atomically, always a static string
+
+    /* the ring of values, shared with the reader */
+    seqlock_t lock;
+    uint64_t num_values;
+    uint64_t utime;
+    double values[WATCH_HISTORY];
+};
+
+watch_t *watch_create(const char *path)
+{
+    // at least "CHANNEL.field"
+    const char *dot = strchr(path, '.');
+    if(dot == NULL || dot == path || dot[1] == '\0') {
+        fprintf(stderr, "ERR: invalid watch '%s', expected CHANNEL.field\n", path);
+        return NULL;
+    }
+
+    watch_t *this = calloc(1, sizeof(watch_t));
+    this->path = strdup(path);
+    this->channel = NULL;
+    pthread_mutex_init(&this->writer_mutex, NULL);
+    this->writer = NULL;
+    this->field_path = NULL;
+    this->is_compiled = 0; /* false */
+    this->error = "waiting for the channel";
+    seqlock_init(&this->lock);
+    return this;
+}
+
+void watch_destroy(watch_t *this)
+{
+    if(this == NULL)
+        return;
+
+    pthread_mutex_destroy(&this->writer_mutex);
+    free(this->path);
+    free(this);
+}
+
+const char *watch_path(const watch_t *this)
+{
+    return this->path;
+}
+
+int watch_bind(watch_t *this, const char *channel)
+{
+    size_t len = strlen(channel);
+    if(strncmp(this->path, channel, len) != 0 || this->path[len] != '.' || this->path[len+1] == '\0')
+        return 0; /* false */
+
+    // several lcm threads may find a matching channel: the longest one wins
+    const char *cur = __atomic_load_n(&this->channel, __ATOMIC_ACQUIRE);
+    do {
+        if(cur != NULL && strlen(cur) >= len)
+            return 0; /* false */
+    } while(!__atomic_compare_exchange_n(&this->channel, &cur, channel, 0,
+                                         __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+    __atomic_store_n(&this->error, "unknown type", __ATOMIC_RELEASE);
+    return 1; /* true */
+}
+
+static inline int is_bound_to(const watch_t *this, const char *channel)
+{
+    return __atomic_load_n(&this->channel, __ATOMIC_ACQUIRE) == channel;
+}
+
+static const lcmtype_field_t *find_field(const lcmtype_fields_t *fields, const char *name, size_t len)
+{
+    for(int i = 0; i < fields->num_fields; i++) {
+        const lcmtype_field_t *field = &fields->fields[i];
+        if(strncmp(field->name, name, len) == 0 && field->name[len] == '\0')
+            return field;
+    }
+    return NULL;
+}
+
+// returns NULL on success, else the reason
+static const char *compile_path(watch_t *this, lcmtype_db_t *db, const lcmtype_metadata_t *metadata)
+{
+    const char *p = this->field_path;
+    const lcmtype_metadata_t *cur = metadata;
+    int64_t offset = 0;
+
+    while(1) {
+        if(cur == NULL)
+            return "unknown nested type";
+
+        size_t n = strcspn(p, ".[");
+        if(n == 0)
+            return "malformed path";
+
+        const lcmtype_field_t *field = find_field(lcmtype_db_get_fields(db, cur), p, n);
+        if(field == NULL)
+            return "no such field";
+        p += n;
+
+        // nested types are encoded without their hash
+        int64_t field_offset = lcmtype_db_wire_offset(db, cur, field);
+        if(field_offset < 0)
+            return "no fixed offset";
+        offset += (cur == metadata) ? field_offset : field_offset - (int64_t) sizeof(int64_t);
+
+        int dim = 0;
+        int64_t index = 0;
+        while(*p == '[') {
+            char *end;
+            long i = strtol(p + 1, &end, 10);
+            if(end == p + 1 || *end != ']')
+                return "malformed index";
+            if(dim == field->num_dim)
+                return "too many indices";
+            if(field->dim_is_variable[dim])
+                return "variable-length array";
+            if(i < 0 || i >= field->dim_size[dim])
+                return "index out of range";
+            index = index * field->dim_size[dim] + i;
+            dim++;
+            p = end + 1;
+        }
+        if(dim != field->num_dim)
+            return "missing index";
+
+        if(field->num_dim > 0) {
+            int64_t elt_size = lcmtype_db_wire_elt_size(db, field);
+            if(elt_size < 0)
+                return "no fixed offset";
+            offset += index * elt_size;
+        }
+
+        if(*p == '\0') {
+            if(field->type == LCM_FIELD_USER_TYPE || field->type == LCM_FIELD_STRING)
+                return "not a number";
+            this->offset = offset;
+            this->type = field->type;
+            return NULL;
+        }
+
+        if(*p != '.' || field->type != LCM_FIELD_USER_TYPE)
+            return "malformed path";
+        cur = field->usertype;
+        p++;
+    }
+}
+
+int watch_compile(watch_t *this, const char *channel, lcmtype_db_t *db,
+                  const lcmtype_metadata_t *metadata)
+{
+    // a channel the watch moved away from
+    if(!is_bound_to(this, channel))
+        return 0;
+
+    pthread_mutex_lock(&this->writer_mutex);
+    if(this->writer != channel) {
+        // the values of the previous channel were of another field
+        this->writer = channel;
+        this->field_path = this->path + strlen(channel) + 1;
+        seqlock_write_begin(&this->lock);
+        this->num_values = 0;
+        this->utime = 0;
+        seqlock_write_end(&this->lock);
+    }
+
+    const char *error = (metadata != NULL) ? compile_path(this, db, metadata) : "unknown type";
+    this->is_compiled = (error == NULL);
+    __atomic_store_n(&this->error, error, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&this->writer_mutex);
+    return (error == NULL) ? 0 : 1;
+}
+
+static inline uint64_t load_be(const uint8_t *p, int n)
+{
+    uint64_t v = 0;
+    for(int i = 0; i < n; i++)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+void watch_add_msg(watch_t *this, const char *channel, uint64_t utime,
+                   const void *data, uint32_t size)
+{
+    if(!is_bound_to(this, channel))
+        return;
+
+    pthread_mutex_lock(&this->writer_mutex);
+    if(!this->is_compiled || this->writer != channel) {
+        pthread_mutex_unlock(&this->writer_mutex);
+        return;
+    }
+
+    const uint8_t *p = (const uint8_t *) data + this->offset;
+    double value;
+    switch(this->type) {
+        case LCM_FIELD_INT8_T:
+        case LCM_FIELD_BOOLEAN:
+            if(this->offset + 1 > size) goto done;
+            value = (int8_t) p[0];
+            break;
+        case LCM_FIELD_BYTE:
+            if(this->offset + 1 > size) goto done;
+            value = p[0];
+            break;
+        case LCM_FIELD_INT16_T:
+            if(this->offset + 2 > size) goto done;
+            value = (int16_t) load_be(p, 2);
+            break;
+        case LCM_FIELD_INT32_T:
+            if(this->offset + 4 > size) goto done;
+            value = (int32_t) load_be(p, 4);
+            break;
+        case LCM_FIELD_INT64_T:
+            if(this->offset + 8 > size) goto done;
+            value = (int64_t) load_be(p, 8);
+            break;
+        case LCM_FIELD_FLOAT: {
+            if(this->offset + 4 > size) goto done;
+            uint32_t bits = load_be(p, 4);
+            float f;
+            memcpy(&f, &bits, sizeof(f));
+            value = f;
+            break;
+        }
+        case LCM_FIELD_DOUBLE: {
+            if(this->offset + 8 > size) goto done;
+            uint64_t bits = load_be(p, 8);
+            memcpy(&value, &bits, sizeof(value));
+            break;
+        }
+        default:
+            goto done;
+    }
+
+    seqlock_write_begin(&this->lock);
+    {
+        this->values[this->num_values % WATCH_HISTORY] = value;
+        this->num_values++;
+        this->utime = utime;
+    }
+    seqlock_write_end(&this->lock);
+
+  done:
+    pthread_mutex_unlock(&this->writer_mutex);
+}
+
+const char *watch_error(const watch_t *this)
+{
+    return __atomic_load_n(&this->error, __ATOMIC_ACQUIRE);
+}
+
+void watch_get(const watch_t *this, watch_snapshot_t *snap)
+{
+    double ring[WATCH_HISTORY];
+    uint32_t s;
+    do {
+        s = seqlock_read_begin(&this->lock);
+        snap->num_values = this->num_values;
+        snap->utime = this->utime;
+        memcpy(ring, this->values, sizeof(ring));
+    } while(seqlock_read_retry(&this->lock, s));
+
+    // unroll the ring, oldest first
+    snap->count = (snap->num_values < WATCH_HISTORY) ? (int) snap->num_values : WATCH_HISTORY;
+    uint64_t first = snap->num_values - snap->count;
+    double sum = 0.0;
+    int num_finite = 0;
+    for(int i = 0; i < snap->count; i++) {
+        double v = ring[(first + i) % WATCH_HISTORY];
+        snap->values[i] = v;
+
+        // a nan or an inf would spread to all of them
+        if(!isfinite(v))
+            continue;
+        if(num_finite == 0 || v < snap->min) snap->min = v;
+        if(num_finite == 0 || v > snap->max) snap->max = v;
+        sum += v;
+        num_finite++;
+    }
+    if(num_finite == 0)
+        snap->min = snap->max = (snap->count > 0) ? NAN : 0.0;
+    snap->mean = (num_finite > 0) ? sum / num_finite : snap->min;
+}
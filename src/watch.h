@@ -0,0 +1,65 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <stdint.h>
+#include "lcmtype_db.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* a watched numeric field, e.g. "POSE.pos[2]" or "STATUS.motor.temp"
+   The path is compiled once per type into an offset in the encoded
+   message, so extracting a value is a bounds check and a big-endian
+   load: no decoding. The field must be at a fixed offset, i.e. only
+   fixed-size fields and fixed arrays come before it.
+
+   The latest WATCH_HISTORY values are kept in a ring, written by the
+   thread handling the channel and read through a seqlock. When the
+   watch moves to a longer channel, the ring starts over.
+*/
+
+#define WATCH_HISTORY 64  /* a power of two */
+
+typedef struct watch watch_t;
+
+typedef struct
+{
+    uint64_t num_values;  // ever added
+    int count;            // in 'values', oldest first
+    double values[WATCH_HISTORY];
+    double min, max, mean;  // over the finite 'values', nan if none is
+    uint64_t utime;       // of the latest value
+
+} watch_snapshot_t;
+
+// returns NULL (and prints why) when 'path' is malformed
+watch_t *watch_create(const char *path);
+void watch_destroy(watch_t *this);
+
+const char *watch_path(const watch_t *this);
+
+// the watch belongs to the longest channel that is a prefix of its path:
+// "A.B.x" moves from channel "A" to channel "A.B" once that one shows up
+// returns whether it was (re)bound to 'channel', which must stay allocated
+int watch_bind(watch_t *this, const char *channel);
+
+// writer: resolves the field path in the channel's type (NULL when unknown)
+// ignored unless 'channel' is the bound one (the same pointer as bound)
+// returns success (0) or failure (1), see watch_error()
+int watch_compile(watch_t *this, const char *channel, lcmtype_db_t *db,
+                  const lcmtype_metadata_t *metadata);
+
+// writer: extracts the value from an encoded message of 'channel', see above
+void watch_add_msg(watch_t *this, const char *channel, uint64_t utime,
+                   const void *data, uint32_t size);
+
+// reader: NULL when values are extracted, else why not
+const char *watch_error(const watch_t *this);
+void watch_get(const watch_t *this, watch_snapshot_t *snap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* WATCH_H */
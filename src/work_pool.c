@@ -0,0 +1,329 @@
+#define _GNU_SOURCE  /* pthread_setaffinity_np() */
+
+#include "work_pool.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <unistd.h>
+
+#define CACHE_LINE 64
+
+/* messages bigger than this fraction of the ring are copied to the heap */
+#define RING_INLINE_FRACTION 4
+
+enum { RECORD_PADDING, RECORD_INLINE, RECORD_BORROWED, RECORD_HEAP };
+
+/* every ring record starts with this header, records are 8-byte aligned */
+typedef struct
+{
+    uint32_t reclen;  // including the header, the data and the alignment
+    uint32_t kind;
+    work_msg_t msg;
+
+} record_t;
+
+/* a single producer, single consumer ring of variable-size records. A
+   record never wraps around the end of the buffer: a padding record
+   fills the rest of the buffer instead.
+*/
+typedef struct
+{
+    uint8_t *buf;
+    uint64_t size;
+    uint64_t mask;
+
+    uint64_t head __attribute__((aligned(CACHE_LINE)));  // written by the producer
+    uint64_t tail_cache;  // producer's last view of 'tail'
+
+    uint64_t tail __attribute__((aligned(CACHE_LINE)));  // written by the consumer
+
+} ring_t;
+
+typedef struct
+{
+    work_pool_t *pool;
+    int index;
+    pthread_t thread;
+    ring_t ring;
+
+    sem_t wakeup;
+    uint32_t is_sleeping;
+    uint32_t is_stopping;
+
+} worker_t;
+
+struct work_pool
+{
+    int num_workers;
+    worker_t *workers;
+    work_handler_t handler;
+    void *usr;
+    uint64_t num_stalls;
+};
+
+static inline uint64_t align8(uint64_t n)
+{
+    return (n + 7) & ~(uint64_t) 7;
+}
+
+static void *worker_func(void *arg);
+
+static void ring_init(ring_t *ring, size_t size)
+{
+    uint64_t sz = 4096;
+    while(sz < size)
+        sz *= 2;
+
+    ring->buf = malloc(sz);
+    ring->size = sz;
+    ring->mask = sz - 1;
+    ring->head = 0;
+    ring->tail_cache = 0;
+    ring->tail = 0;
+}
+
+static void pin_thread(pthread_t thread, int core)
+{
+#ifdef __linux__
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(core, &cpus);
+    if(pthread_setaffinity_np(thread, sizeof(cpus), &cpus) != 0)
+        fprintf(stderr, "WRN: failed to pin a worker to core %d\n", core);
+#endif
+}
+
+work_pool_t *work_pool_create(int num_workers, size_t ring_size, int first_core,
+                              work_handler_t handler, void *usr)
+{
+    work_pool_t *this = calloc(1, sizeof(work_pool_t));
+    this->num_workers = num_workers;
+    this->handler = handler;
+    this->usr = usr;
+    this->num_stalls = 0;
+
+    // the workers are aligned, so their rings don't share cache lines
+    if(posix_memalign((void **) &this->workers, CACHE_LINE, num_workers * sizeof(worker_t)) != 0) {
+        free(this);
+        return NULL;
+    }
+    memset(this->workers, 0, num_workers * sizeof(worker_t));
+
+    long num_cores = sysconf(_SC_NPROCESSORS_ONLN);
+    for(int i = 0; i < num_workers; i++) {
+        worker_t *w = &this->workers[i];
+        w->pool = this;
+        w->index = i;
+        ring_init(&w->ring, ring_size);
+        sem_init(&w->wakeup, 0, 0);
+        w->is_sleeping = 0;
+        w->is_stopping = 0;
+
+        if(pthread_create(&w->thread, NULL, worker_func, w) != 0) {
+            fprintf(stderr, "ERR: failed to start worker %d\n", i);
+            this->num_workers = i;
+            work_pool_destroy(this);
+            return NULL;
+        }
+        if(first_core >= 0 && num_cores > 1)
+            pin_thread(w->thread, (first_core + i) % num_cores);
+    }
+
+    return this;
+}
+
+/* the worker stores 'is_sleeping' then loads 'head', we store 'head' then
+   load 'is_sleeping': without a full fence between our store and load,
+   both loads may miss the other store and the worker sleeps on a message */
+static inline void wake(worker_t *w)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&w->is_sleeping, __ATOMIC_SEQ_CST) &&
+       __atomic_exchange_n(&w->is_sleeping, 0, __ATOMIC_SEQ_CST))
+        sem_post(&w->wakeup);
+}
+
+void work_pool_destroy(work_pool_t *this)
+{
+    if(this == NULL)
+        return;
+
+    for(int i = 0; i < this->num_workers; i++) {
+        worker_t *w = &this->workers[i];
+        __atomic_store_n(&w->is_stopping, 1, __ATOMIC_SEQ_CST);
+        sem_post(&w->wakeup);
+    }
+
+    for(int i = 0; i < this->num_workers; i++) {
+        worker_t *w = &this->workers[i];
+        pthread_join(w->thread, NULL);
+        sem_destroy(&w->wakeup);
+        free(w->ring.buf);
+    }
+
+    free(this->workers);
+    free(this);
+}
+
+int work_pool_num_workers(const work_pool_t *this)
+{
+    return this->num_workers;
+}
+
+void work_pool_submit(work_pool_t *this, unsigned shard, void *ctx, int64_t utime,
+                      const void *data, uint32_t size, int copy)
+{
+    worker_t *w = &this->workers[shard % this->num_workers];
+    ring_t *ring = &w->ring;
+
+    uint32_t kind = RECORD_BORROWED;
+    uint64_t reclen = sizeof(record_t);
+    if(copy) {
+        if(size <= ring->size / RING_INLINE_FRACTION) {
+            kind = RECORD_INLINE;
+            reclen += size;
+        } else {
+            kind = RECORD_HEAP;
+        }
+    }
+    reclen = align8(reclen);
+
+    // the space needed, including the padding up to the end of the buffer
+    uint64_t head = ring->head;
+    uint64_t pos = head & ring->mask;
+    uint64_t padding = (pos + reclen > ring->size) ? ring->size - pos : 0;
+    uint64_t need = padding + reclen;
+
+    if(head + need - ring->tail_cache > ring->size) {
+        ring->tail_cache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if(head + need - ring->tail_cache > ring->size) {
+            __atomic_add_fetch(&this->num_stalls, 1, __ATOMIC_RELAXED);
+            do {
+                wake(w);
+                sched_yield();
+                ring->tail_cache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+            } while(head + need - ring->tail_cache > ring->size);
+        }
+    }
+
+    if(padding) {
+        record_t *pad = (record_t *) (ring->buf + pos);
+        pad->reclen = padding;
+        pad->kind = RECORD_PADDING;
+        pos = 0;
+    }
+
+    record_t *rec = (record_t *) (ring->buf + pos);
+    rec->reclen = reclen;
+    rec->kind = kind;
+    rec->msg.ctx = ctx;
+    rec->msg.utime = utime;
+    rec->msg.size = size;
+    switch(kind) {
+        case RECORD_INLINE:
+            memcpy(rec + 1, data, size);
+            rec->msg.data = rec + 1;
+            break;
+        case RECORD_HEAP: {
+            void *copy = malloc(size);
+            memcpy(copy, data, size);
+            rec->msg.data = copy;
+            break;
+        }
+        default:
+            rec->msg.data = data;
+            break;
+    }
+
+    __atomic_store_n(&ring->head, head + need, __ATOMIC_RELEASE);
+    wake(w);
+}
+
+void work_pool_drain(work_pool_t *this)
+{
+    for(int i = 0; i < this->num_workers; i++) {
+        worker_t *w = &this->workers[i];
+        while(__atomic_load_n(&w->ring.tail, __ATOMIC_ACQUIRE) != w->ring.head) {
+            wake(w);
+            sched_yield();
+        }
+    }
+}
+
+uint64_t work_pool_num_stalls(const work_pool_t *this)
+{
+    return __atomic_load_n(&this->num_stalls, __ATOMIC_RELAXED);
+}
+
+double work_pool_max_fill(const work_pool_t *this)
+{
+    uint64_t max_used = 0;
+    for(int i = 0; i < this->num_workers; i++) {
+        const ring_t *ring = &this->workers[i].ring;
+        uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+        if(head - tail > max_used && head >= tail)
+            max_used = head - tail;
+    }
+    return (this->num_workers > 0) ? (double) max_used / this->workers[0].ring.size : 0.0;
+}
+
+// processes everything in the ring, returns non-zero if there was anything
+static int worker_run(worker_t *w)
+{
+    ring_t *ring = &w->ring;
+    work_pool_t *pool = w->pool;
+
+    uint64_t tail = ring->tail;
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    if(tail == head)
+        return 0;
+
+    while(tail != head) {
+        record_t *rec = (record_t *) (ring->buf + (tail & ring->mask));
+        if(rec->kind != RECORD_PADDING) {
+            pool->handler(pool->usr, &rec->msg);
+            if(rec->kind == RECORD_HEAP)
+                free((void *) rec->msg.data);
+        }
+        tail += rec->reclen;
+
+        // hand the space back as we go, the producer may be waiting for it
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+        if(tail == head)
+            head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    }
+
+    return 1;
+}
+
+static void *worker_func(void *arg)
+{
+    worker_t *w = arg;
+    ring_t *ring = &w->ring;
+
+    for(;;) {
+        if(worker_run(w))
+            continue;
+
+        if(__atomic_load_n(&w->is_stopping, __ATOMIC_SEQ_CST))
+            break;
+
+        // announce that we sleep, then check once more before really sleeping
+        __atomic_store_n(&w->is_sleeping, 1, __ATOMIC_SEQ_CST);
+        if(__atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) != ring->tail ||
+           __atomic_load_n(&w->is_stopping, __ATOMIC_SEQ_CST)) {
+            // the producer may have cleared the flag and posted meanwhile
+            if(__atomic_exchange_n(&w->is_sleeping, 0, __ATOMIC_SEQ_CST) == 0)
+                sem_wait(&w->wakeup);
+            continue;
+        }
+        sem_wait(&w->wakeup);
+    }
+
+    return NULL;
+}
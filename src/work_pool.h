@@ -0,0 +1,57 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* a pool of worker threads fed with messages by ONE producer thread.
+   Each worker has its own lock-free ring: messages submitted to the same
+   shard are handled by the same worker, in submission order. Message data
+   is copied into the ring (or borrowed, if it outlives the processing),
+   so the producer never waits for the processing itself.
+*/
+
+typedef struct
+{
+    void *ctx;
+    int64_t utime;
+    const void *data;
+    uint32_t size;
+
+} work_msg_t;
+
+typedef void (*work_handler_t)(void *usr, const work_msg_t *msg);
+
+typedef struct work_pool work_pool_t;
+
+// 'ring_size' is per worker, rounded up to a power of two
+// unless 'first_core' is -1, worker i is pinned to core (first_core + i) % num_cores
+work_pool_t *work_pool_create(int num_workers, size_t ring_size, int first_core,
+                              work_handler_t handler, void *usr);
+// processes what is still queued, then stops the workers
+void work_pool_destroy(work_pool_t *this);
+
+int work_pool_num_workers(const work_pool_t *this);
+
+// 'copy' copies 'data' into the queue, otherwise it must stay valid until processed
+void work_pool_submit(work_pool_t *this, unsigned shard, void *ctx, int64_t utime,
+                      const void *data, uint32_t size, int copy);
+
+// waits until everything submitted so far has been processed
+void work_pool_drain(work_pool_t *this);
+
+// the number of times the producer had to wait for a full ring
+uint64_t work_pool_num_stalls(const work_pool_t *this);
+
+// how full the fullest worker ring is, from 0 to 1
+double work_pool_max_fill(const work_pool_t *this);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* WORK_POOL_H */